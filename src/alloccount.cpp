@@ -0,0 +1,32 @@
+#include "alloccount.h"
+
+#include <cstdlib>
+#include <new>
+
+// plain int, nothing to construct before the first allocation
+static thread_local long long allocations = 0;
+
+long long ThreadAllocations()
+{
+    return allocations;
+}
+
+// new[] and the nothrow forms end up in here as well
+void *operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
@@ -0,0 +1,10 @@
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+// the game replaces operator new with one that counts, so the stats overlay
+// and the render benchmark can show which frames touch the heap. the count
+// is per thread: the persistence worker and level builds don't show up in
+// the main thread's frames
+long long ThreadAllocations();
+
+#endif
@@ -0,0 +1,361 @@
+#include "arena.h"
+
+#include <cstdlib>
+
+// same splitmix64 as the single player game
+static uint64_t NextRandom(Arena &arena)
+{
+    uint64_t z = (arena.rngState += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static int RandomBelow(Arena &arena, int n)
+{
+    return (int)(NextRandom(arena) % (uint64_t)n);
+}
+
+// a random empty cell. the arena is mostly empty, so random tries almost
+// always land on one and the board doesn't need a free cell index that every
+// move would have to update. -1 if none of the tries found one
+static int RandomEmptyCell(Arena &arena)
+{
+    int cells = arena.width * arena.height;
+    for (int tries = 0; tries < 64; tries++)
+    {
+        int cell = RandomBelow(arena, cells);
+        if (arena.owner[cell] == 0)
+            return cell;
+    }
+    return -1;
+}
+
+static void LogChange(Arena &arena, ArenaChangeKind kind, int snake, int cell, char key, bool grew)
+{
+    if (arena.logChanges)
+        arena.changes.push_back({(uint8_t)kind, key, grew, snake, cell});
+}
+
+static bool SpawnArenaFood(Arena &arena)
+{
+    int cell = RandomEmptyCell(arena);
+    if (cell < 0)
+        return false;
+    LogChange(arena, ARENA_FOOD, -1, cell, 0, false);
+    arena.owner[cell] = -1;
+    arena.foodSlot[cell] = (int32_t)arena.foods.size();
+    arena.foods.push_back(cell);
+    return true;
+}
+
+static void RemoveArenaFood(Arena &arena, int cell)
+{
+    int slot = arena.foodSlot[cell];
+    int last = arena.foods.back();
+    arena.foods[slot] = last;
+    arena.foodSlot[last] = slot;
+    arena.foods.pop_back();
+    arena.foodSlot[cell] = -1;
+}
+
+// a lone head on a random free cell, it grows to length 4 over its first moves
+static bool SpawnArenaSnake(Arena &arena, int index)
+{
+    int cell = RandomEmptyCell(arena);
+    if (cell < 0)
+        return false;
+    ArenaSnake &snake = arena.snakes[index];
+    arena.owner[cell] = index + 1;
+    snake.body.Clear();
+    snake.body.PushHead(cell % arena.width, cell / arena.width);
+    snake.key = "RLUD"[RandomBelow(arena, 4)];
+    snake.alive = true;
+    snake.grow = 3;
+    snake.score = 0;
+    snake.target = -1;
+    snake.turn = 0;
+    LogChange(arena, ARENA_SPAWN, index, cell, snake.key, false);
+    return true;
+}
+
+static int Distance(const Arena &arena, int a, int b)
+{
+    return abs(a % arena.width - b % arena.width) + abs(a / arena.width - b / arena.width);
+}
+
+// nearest of a few random foods, checking them all would cost foods x snakes
+static int PickTarget(Arena &arena, int from)
+{
+    if (arena.foods.empty())
+        return -1;
+    int best = -1;
+    int bestDist = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int cell = arena.foods[RandomBelow(arena, (int)arena.foods.size())];
+        int dist = Distance(arena, from, cell);
+        if (best < 0 || dist < bestDist)
+        {
+            best = cell;
+            bestDist = dist;
+        }
+    }
+    return best;
+}
+
+// cell one step from (x, y), -1 off the board
+static int Neighbor(const Arena &arena, int x, int y, char dir)
+{
+    switch (dir)
+    {
+    case 'R':
+        x++;
+        break;
+    case 'L':
+        x--;
+        break;
+    case 'U':
+        y--;
+        break;
+    case 'D':
+        y++;
+        break;
+    }
+    if (x < 0 || x >= arena.width || y < 0 || y >= arena.height)
+        return -1;
+    return y * arena.width + x;
+}
+
+static bool IsOpen(const Arena &arena, int cell)
+{
+    return cell >= 0 && arena.owner[cell] <= 0;
+}
+
+// greedy bot: eat what is next to it, otherwise head for the target while
+// keeping away from cells with no way out. looks at the cells around the head only
+static void DecideArenaMove(Arena &arena, ArenaSnake &snake)
+{
+    const Cell &head = snake.body.Head();
+    int headCell = head.y * arena.width + head.x;
+    if (snake.target < 0 || arena.owner[snake.target] != -1)
+        snake.target = PickTarget(arena, headCell);
+
+    const char dirs[] = {'R', 'L', 'U', 'D'};
+    const char back[] = {'L', 'R', 'D', 'U'};
+    int bestScore = 0;
+    char bestDir = 0;
+    for (int d = 0; d < 4; d++)
+    {
+        if (back[d] == snake.key && snake.body.Length() > 1)
+            continue;
+        int cell = Neighbor(arena, head.x, head.y, dirs[d]);
+        if (!IsOpen(arena, cell))
+            continue;
+
+        int exits = 0;
+        int cx = cell % arena.width;
+        int cy = cell / arena.width;
+        for (int e = 0; e < 4; e++)
+            exits += IsOpen(arena, Neighbor(arena, cx, cy, dirs[e]));
+
+        int score = exits * 8;
+        if (arena.owner[cell] < 0)
+            score += 1000;
+        if (snake.target >= 0)
+            score -= Distance(arena, cell, snake.target);
+        if (bestDir == 0 || score > bestScore)
+        {
+            bestScore = score;
+            bestDir = dirs[d];
+        }
+    }
+
+    // boxed in, going straight ahead is as good as anything
+    if (bestDir != 0)
+        snake.key = bestDir;
+    snake.next = Neighbor(arena, head.x, head.y, snake.key);
+}
+
+// takes the player's turn unless it would reverse into the body
+static void PlayerArenaMove(Arena &arena, ArenaSnake &snake)
+{
+    const Cell &head = snake.body.Head();
+    char turn = snake.turn;
+    snake.turn = 0;
+    bool reverse = (turn == 'R' && snake.key == 'L') || (turn == 'L' && snake.key == 'R') ||
+                   (turn == 'U' && snake.key == 'D') || (turn == 'D' && snake.key == 'U');
+    if ((turn == 'R' || turn == 'L' || turn == 'U' || turn == 'D') && !(reverse && snake.body.Length() > 1))
+        snake.key = turn;
+    snake.next = Neighbor(arena, head.x, head.y, snake.key);
+}
+
+void InitArena(Arena &arena, int width, int height, int snakeCount, int foodCount, uint64_t seed)
+{
+    int cells = width * height;
+    arena.width = width;
+    arena.height = height;
+    arena.foodCount = foodCount;
+    arena.tick = 0;
+    arena.rngState = seed;
+    arena.owner.assign(cells, 0);
+    arena.claims.assign(cells, ~0ull);
+    arena.foodSlot.assign(cells, -1);
+    arena.foods.clear();
+    arena.foods.reserve(foodCount);
+    arena.changes.clear();
+
+    arena.snakes.assign(snakeCount, ArenaSnake());
+    for (int i = 0; i < snakeCount; i++)
+    {
+        arena.snakes[i].body.Reserve(16);
+        SpawnArenaSnake(arena, i);
+    }
+    for (int i = 0; i < foodCount; i++)
+        SpawnArenaFood(arena);
+    arena.changes.clear();
+}
+
+int AddArenaSnake(Arena &arena, bool player)
+{
+    ArenaSnake snake;
+    snake.player = player;
+    snake.respawnIn = 1;
+    snake.body.Reserve(16);
+    arena.snakes.push_back(snake);
+    return (int)arena.snakes.size() - 1;
+}
+
+ArenaTickStats StepArena(Arena &arena)
+{
+    ArenaTickStats stats;
+    arena.tick++;
+    arena.changes.clear();
+    int count = (int)arena.snakes.size();
+
+    // snakes that came back this tick sit still until the next one
+    for (int i = 0; i < count; i++)
+    {
+        ArenaSnake &snake = arena.snakes[i];
+        snake.moving = false;
+        snake.popped = false;
+        snake.dies = false;
+        if (!snake.alive && --snake.respawnIn <= 0 && SpawnArenaSnake(arena, i))
+        {
+            snake.respawnIn = 0;
+            stats.spawned++;
+        }
+        else if (snake.alive)
+        {
+            if (snake.player)
+                PlayerArenaMove(arena, snake);
+            else
+                DecideArenaMove(arena, snake);
+            snake.moving = true;
+            stats.moved++;
+        }
+    }
+
+    // tails leave first, so following a tail that moves is fine
+    for (int i = 0; i < count; i++)
+    {
+        ArenaSnake &snake = arena.snakes[i];
+        if (!snake.moving || (snake.next >= 0 && arena.owner[snake.next] < 0))
+            continue;
+        if (snake.grow > 0)
+        {
+            snake.grow--;
+            continue;
+        }
+        const Cell &tail = snake.body.Tail();
+        int cell = tail.y * arena.width + tail.x;
+        arena.owner[cell] = 0;
+        snake.body.PopTail();
+        snake.popped = true;
+    }
+
+    // two heads on one cell, both die
+    uint64_t stamp = (uint64_t)arena.tick << 32;
+    for (int i = 0; i < count; i++)
+    {
+        ArenaSnake &snake = arena.snakes[i];
+        if (!snake.moving)
+            continue;
+        if (snake.next < 0)
+        {
+            snake.dies = true;
+            continue;
+        }
+        uint64_t &claim = arena.claims[snake.next];
+        if ((claim & 0xFFFFFFFF00000000ull) == stamp)
+        {
+            snake.dies = true;
+            arena.snakes[claim & 0xFFFFFFFFull].dies = true;
+        }
+        else
+        {
+            claim = stamp | (uint32_t)i;
+        }
+    }
+
+    // a head on any body, including ones that die this tick
+    for (int i = 0; i < count; i++)
+    {
+        ArenaSnake &snake = arena.snakes[i];
+        if (snake.moving && !snake.dies && arena.owner[snake.next] > 0)
+            snake.dies = true;
+    }
+
+    // survivors move, the dead clear off the board
+    for (int i = 0; i < count; i++)
+    {
+        ArenaSnake &snake = arena.snakes[i];
+        if (!snake.moving)
+            continue;
+        if (!snake.dies)
+        {
+            int cell = snake.next;
+            if (arena.owner[cell] < 0)
+            {
+                RemoveArenaFood(arena, cell);
+                snake.score++;
+                snake.target = -1;
+                stats.ate++;
+            }
+            LogChange(arena, ARENA_MOVE, i, cell, snake.key, !snake.popped);
+            arena.owner[cell] = i + 1;
+            snake.body.PushHead(cell % arena.width, cell / arena.width);
+        }
+        else
+        {
+            for (int s = 0; s < snake.body.Length(); s++)
+                arena.owner[snake.body.At(s).y * arena.width + snake.body.At(s).x] = 0;
+            snake.body.Clear();
+            snake.alive = false;
+            snake.respawnIn = arena.respawnDelay;
+            stats.died++;
+            LogChange(arena, ARENA_DIE, i, -1, 0, false);
+        }
+    }
+
+    while ((int)arena.foods.size() < arena.foodCount && SpawnArenaFood(arena))
+    {
+    }
+    return stats;
+}
+
+int ArenaAliveCount(const Arena &arena)
+{
+    int alive = 0;
+    for (const ArenaSnake &snake : arena.snakes)
+        alive += snake.alive;
+    return alive;
+}
+
+int ArenaBodyCells(const Arena &arena)
+{
+    int cells = 0;
+    for (const ArenaSnake &snake : arena.snakes)
+        cells += snake.body.Length();
+    return cells;
+}
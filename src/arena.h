@@ -0,0 +1,91 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "snakebody.h"
+
+// one bot snake in the arena
+struct ArenaSnake
+{
+    SnakeBody body;
+    char key = 'R';
+    bool alive = false;
+    int grow = 0;       // segments still to add, a snake spawns as a lone head
+    int score = 0;
+    int respawnIn = 0;  // ticks until a dead snake comes back
+    int target = -1;    // food cell it is heading for
+    bool player = false; // steered by turn instead of the bot
+    char turn = 0;       // a player's latest turn, used up by the next tick
+    // set while a tick is being resolved
+    bool moving = false;
+    int next = -1; // cell the head moves to, -1 into a wall
+    bool popped = false;
+    bool dies = false;
+};
+
+// something that happened during a tick. a copy of the board kept elsewhere
+// (a network client) stays in sync by applying these in order
+enum ArenaChangeKind
+{
+    ARENA_SPAWN = 0, // snake appeared as a lone head on cell, facing key
+    ARENA_MOVE,      // head moved one step toward key, the tail stayed if grew
+    ARENA_DIE,       // body removed
+    ARENA_FOOD       // food appeared on cell
+};
+
+struct ArenaChange
+{
+    uint8_t kind;
+    char key;
+    bool grew;
+    int32_t snake;
+    int32_t cell;
+};
+
+// many snakes on one walled board. every snake picks its move first, then
+// all of them move at once: tails that leave free their cells, two heads on
+// one cell kill both, a head on any body kills that snake. each pass walks
+// the snakes in index order, so the same seed always plays the same game.
+// a tick only touches heads, tails and the bodies of snakes that died, so it
+// costs the same no matter how many snakes could have hit each other
+struct Arena
+{
+    int width = 0;
+    int height = 0;
+    int foodCount = 0;     // food kept on the board
+    int respawnDelay = 20;
+    uint32_t tick = 0;
+    uint64_t rngState = 0;
+
+    std::vector<ArenaSnake> snakes;
+    std::vector<int32_t> owner;    // per cell, snake index + 1, -1 for food or 0 when empty
+    std::vector<uint64_t> claims;  // per cell, tick << 32 | snake index of the last head that wanted it
+    std::vector<int32_t> foodSlot; // per cell, index into foods or -1
+    std::vector<int> foods;
+
+    // filled by every StepArena while logChanges is on
+    bool logChanges = false;
+    std::vector<ArenaChange> changes;
+};
+
+// what happened during one tick
+struct ArenaTickStats
+{
+    int moved = 0;
+    int ate = 0;
+    int died = 0;
+    int spawned = 0;
+};
+
+// sizes the board and spawns every snake as a head that grows to length 4
+void InitArena(Arena &arena, int width, int height, int snakeCount, int foodCount, uint64_t seed);
+ArenaTickStats StepArena(Arena &arena);
+
+// one more snake, it spawns on the next tick. returns its index
+int AddArenaSnake(Arena &arena, bool player);
+int ArenaAliveCount(const Arena &arena);
+int ArenaBodyCells(const Arena &arena);
+
+#endif
@@ -0,0 +1,538 @@
+#include "autopilot.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+static const char dirKeys[4] = {'R', 'L', 'U', 'D'};
+static const int dirX[4] = {1, -1, 0, 0};
+static const int dirY[4] = {0, 0, -1, 1};
+static const int opposite[4] = {1, 0, 3, 2};
+
+static int DirIndex(char key)
+{
+    for (int d = 0; d < 4; d++)
+    {
+        if (dirKeys[d] == key)
+            return d;
+    }
+    return 0;
+}
+
+// neighbour of (x, y) in direction d, false when it would leave a walled board
+static bool Neighbor(const GameState &game, bool walls, int x, int y, int d, int &nx, int &ny)
+{
+    nx = x + dirX[d];
+    ny = y + dirY[d];
+    if (nx < 0 || nx >= game.gridCountX || ny < 0 || ny >= game.gridCountY)
+    {
+        if (walls)
+            return false;
+        nx = (nx + game.gridCountX) % game.gridCountX;
+        ny = (ny + game.gridCountY) % game.gridCountY;
+    }
+    return true;
+}
+
+// manhattan distance, around the edges when the board wraps
+static uint32_t Heuristic(const GameState &game, bool walls, int x, int y, int gx, int gy)
+{
+    int dx = abs(x - gx);
+    int dy = abs(y - gy);
+    if (!walls)
+    {
+        dx = std::min(dx, game.gridCountX - dx);
+        dy = std::min(dy, game.gridCountY - dy);
+    }
+    return (uint32_t)(dx + dy);
+}
+
+// sizes the scratch arrays to the board, only does work when the board changed
+static void Prepare(Autopilot &ap, const GameState &game)
+{
+    if (ap.width == game.gridCountX && ap.height == game.gridCountY)
+        return;
+
+    size_t cells = (size_t)game.gridCountX * game.gridCountY;
+    ap.width = game.gridCountX;
+    ap.height = game.gridCountY;
+    ap.closed.assign(cells, 0);
+    ap.marks.assign(cells, 0);
+    ap.searchGen = 0;
+    ap.markGen = 0;
+    ResetAutopilot(ap);
+}
+
+// cell the snake can move into: empty, or its tail which moves out first
+static bool CanEnter(const GameState &game, bool hurdles, int x, int y)
+{
+    const Cell &tail = game.snake.Tail();
+    if (x == tail.x && y == tail.y)
+        return true;
+    return !IsTileBlocked(x, y, game, hurdles);
+}
+
+// A* from (sx, sy) to (gx, gy). the goal always counts as enterable, other
+// cells ask blocked(x, y, id). leaves the cells after the start up to and
+// including the goal in ap.found. gives up once the decision has used up
+// its searchBudget expansions.
+// on a grid a step changes f = g + h by 0, 1 or 2, so the open set is four
+// buckets by f instead of a heap, and popping the newest entry of a bucket
+// keeps going deeper on ties
+template <typename Blocked>
+static bool FindPath(Autopilot &ap, const GameState &game, int sx, int sy, int gx, int gy, int bannedDir, Blocked blocked)
+{
+    if (sx == gx && sy == gy)
+        return false;
+
+    if (++ap.searchGen >= (1u << 30))
+    {
+        std::fill(ap.closed.begin(), ap.closed.end(), 0);
+        ap.searchGen = 1;
+    }
+    const uint32_t gen = ap.searchGen;
+    bool walls = WallsActive(game);
+    int w = ap.width;
+    uint32_t start = (uint32_t)(sy * w + sx);
+    uint32_t goal = (uint32_t)(gy * w + gx);
+
+    for (int i = 0; i < 4; i++)
+        ap.buckets[i].clear();
+    uint32_t f = Heuristic(game, walls, sx, sy, gx, gy);
+    ap.buckets[f & 3].push_back(start << 2);
+    size_t openCount = 1;
+    bool reached = false;
+    while (openCount > 0)
+    {
+        while (ap.buckets[f & 3].empty())
+            f++;
+        uint32_t entry = ap.buckets[f & 3].back();
+        ap.buckets[f & 3].pop_back();
+        openCount--;
+
+        uint32_t cell = entry >> 2;
+        if ((ap.closed[cell] >> 2) == gen)
+            continue;
+        ap.closed[cell] = (gen << 2) | (entry & 3);
+        if (cell == goal)
+        {
+            reached = true;
+            break;
+        }
+        if (++ap.spent > ap.searchBudget)
+            return false;
+
+        int x = (int)(cell % w);
+        int y = (int)(cell / w);
+        uint32_t g = f - Heuristic(game, walls, x, y, gx, gy);
+        for (int d = 0; d < 4; d++)
+        {
+            if (cell == start && d == bannedDir)
+                continue;
+            int nx, ny;
+            if (!Neighbor(game, walls, x, y, d, nx, ny))
+                continue;
+            uint32_t id = (uint32_t)(ny * w + nx);
+            if ((ap.closed[id] >> 2) == gen || (id != goal && blocked(nx, ny, id)))
+                continue;
+            uint32_t nf = g + 1 + Heuristic(game, walls, nx, ny, gx, gy);
+            ap.buckets[nf & 3].push_back((id << 2) | (uint32_t)d);
+            openCount++;
+        }
+    }
+    if (!reached)
+        return false;
+
+    // walk back from the goal, then flip
+    ap.found.clear();
+    uint32_t cell = goal;
+    while (cell != start)
+    {
+        int x = (int)(cell % w);
+        int y = (int)(cell / w);
+        ap.found.push_back({x, y});
+        int px, py;
+        Neighbor(game, walls, x, y, opposite[ap.closed[cell] & 3], px, py);
+        cell = (uint32_t)(py * w + px);
+    }
+    std::reverse(ap.found.begin(), ap.found.end());
+    return true;
+}
+
+static int DirTo(const GameState &game, const Cell &from, const Cell &to)
+{
+    bool walls = WallsActive(game);
+    for (int d = 0; d < 4; d++)
+    {
+        int nx, ny;
+        if (Neighbor(game, walls, from.x, from.y, d, nx, ny) && nx == to.x && ny == to.y)
+            return d;
+    }
+    return -1;
+}
+
+// imagines the snake after following p and eating at its end, and checks it
+// could still reach its own tail from there. if it can it can never get stuck
+static bool PathIsSafe(Autopilot &ap, const GameState &game, const std::vector<Cell> &p)
+{
+    if (++ap.markGen >= 0x7FFFFFFF)
+    {
+        std::fill(ap.marks.begin(), ap.marks.end(), 0);
+        ap.markGen = 1;
+    }
+    const uint32_t freed = ap.markGen * 2;
+    const uint32_t taken = ap.markGen * 2 + 1;
+    const SnakeBody &body = game.snake;
+    int length = body.Length();
+    int k = (int)p.size();
+    int w = ap.width;
+
+    // every move but the last (which eats) takes the tail along
+    for (int s = 1; s <= k - 1 && s <= length; s++)
+    {
+        const Cell &c = body.At(length - s);
+        ap.marks[c.y * w + c.x] = freed;
+    }
+    // the new body is the last length + 1 cells of head positions
+    for (int i = std::max(0, k - 1 - length); i < k; i++)
+        ap.marks[p[i].y * w + p[i].x] = taken;
+
+    Cell tail = k - 1 < length ? body.At(length - k) : p[k - 1 - length];
+    const Cell &before = k >= 2 ? p[k - 2] : body.Head();
+    const Cell &head = p[k - 1];
+    bool walls = WallsActive(game);
+    int lastDir = 0;
+    for (int d = 0; d < 4; d++)
+    {
+        int nx, ny;
+        if (Neighbor(game, walls, before.x, before.y, d, nx, ny) && nx == head.x && ny == head.y)
+            lastDir = d;
+    }
+
+    bool hurdles = HurdlesActive(game);
+    return FindPath(ap, game, head.x, head.y, tail.x, tail.y, opposite[lastDir], [&](int x, int y, uint32_t id) {
+        if (ap.marks[id] == taken)
+            return true;
+        if (ap.marks[id] == freed)
+            return hurdles && game.hurdleCells.Test(x, y);
+        return IsTileBlocked(x, y, game, hurdles);
+    });
+}
+
+
+// stretches ap.found (the path on from the head) by swapping straight steps
+// for three step detours through free cells beside them. chasing the tail the
+// long way round leaves the snake more room than the shortest way would
+static void StretchPath(Autopilot &ap, const GameState &game, const Cell &head)
+{
+    if (++ap.markGen >= 0x7FFFFFFF)
+    {
+        std::fill(ap.marks.begin(), ap.marks.end(), 0);
+        ap.markGen = 1;
+    }
+    const uint32_t onPath = ap.markGen * 2 + 1;
+    int w = ap.width;
+    ap.marks[head.y * w + head.x] = onPath;
+    for (const Cell &c : ap.found)
+        ap.marks[c.y * w + c.x] = onPath;
+
+    bool walls = WallsActive(game);
+    bool hurdles = HurdlesActive(game);
+    auto isFree = [&](int x, int y) {
+        return ap.marks[y * w + x] != onPath && !(x == game.foodX && y == game.foodY) && !IsTileBlocked(x, y, game, hurdles);
+    };
+
+    int work = 0;
+    bool changed = true;
+    while (changed && work < ap.searchBudget)
+    {
+        changed = false;
+        ap.stretched.clear();
+        Cell prev = head;
+        for (const Cell &next : ap.found)
+        {
+            int d = DirTo(game, prev, next);
+            int sides[2] = {d < 2 ? 2 : 0, d < 2 ? 3 : 1};
+            for (int side : sides)
+            {
+                int ax, ay, bx, by;
+                if (Neighbor(game, walls, prev.x, prev.y, side, ax, ay) && Neighbor(game, walls, next.x, next.y, side, bx, by) &&
+                    isFree(ax, ay) && isFree(bx, by))
+                {
+                    ap.marks[ay * w + ax] = onPath;
+                    ap.marks[by * w + bx] = onPath;
+                    ap.stretched.push_back({ax, ay});
+                    ap.stretched.push_back({bx, by});
+                    changed = true;
+                    break;
+                }
+            }
+            ap.stretched.push_back(next);
+            prev = next;
+            work++;
+        }
+        ap.found.swap(ap.stretched);
+    }
+}
+
+// next step along a cached path, -1 once it is used up or no longer fits
+static int FollowPath(const GameState &game, const std::vector<Cell> &path, size_t &pos, int bannedDir)
+{
+    if (pos >= path.size())
+        return -1;
+    const Cell &next = path[pos];
+    int d = DirTo(game, game.snake.Head(), next);
+    if (d < 0 || d == bannedDir || !CanEnter(game, HurdlesActive(game), next.x, next.y))
+        return -1;
+    pos++;
+    return d;
+}
+
+static int DecidePath(Autopilot &ap, GameState &game, int bannedDir)
+{
+    const Cell head = game.snake.Head();
+    const Cell tail = game.snake.Tail();
+    bool hurdles = HurdlesActive(game);
+    auto blocked = [&](int x, int y, uint32_t) {
+        return !CanEnter(game, hurdles, x, y);
+    };
+
+    // a path to the food stays good until the food is eaten, the snake
+    // only ever moves along it
+    if (ap.pathFoodX == game.foodX && ap.pathFoodY == game.foodY)
+    {
+        int d = FollowPath(game, ap.foodPath, ap.foodPos, bannedDir);
+        if (d >= 0)
+            return d;
+    }
+
+    // new food, or chasing the tail: see if the food can safely be had now
+    if (ap.foodRetry > 0)
+    {
+        ap.foodRetry--;
+    }
+    else if (game.foodX >= 0)
+    {
+        if (FindPath(ap, game, head.x, head.y, game.foodX, game.foodY, bannedDir, blocked))
+        {
+            ap.foodPath.swap(ap.found);
+            ap.foodPos = 0;
+            ap.pathFoodX = game.foodX;
+            ap.pathFoodY = game.foodY;
+            if (PathIsSafe(ap, game, ap.foodPath))
+            {
+                ap.tailPath.clear();
+                return FollowPath(game, ap.foodPath, ap.foodPos, bannedDir);
+            }
+        }
+        ap.foodPath.clear();
+        ap.pathFoodX = -1;
+        ap.pathFoodY = -1;
+        ap.foodRetry = 4; // chase the tail a few ticks before looking again
+    }
+
+    // follow the tail, the space it leaves is always safe to move into
+    int d = FollowPath(game, ap.tailPath, ap.tailPos, bannedDir);
+    if (d >= 0)
+        return d;
+    if (FindPath(ap, game, head.x, head.y, tail.x, tail.y, bannedDir, blocked))
+    {
+        StretchPath(ap, game, head);
+        ap.tailPath.swap(ap.found);
+        ap.tailPos = 0;
+        d = FollowPath(game, ap.tailPath, ap.tailPos, bannedDir);
+        if (d >= 0)
+            return d;
+    }
+
+    // boxed in or out of budget: the open neighbour with the most open
+    // neighbours, closest to the food on ties so huge open boards still
+    // get somewhere while the searches can't reach that far
+    bool walls = WallsActive(game);
+    int best = -1;
+    int bestRoom = -1;
+    uint32_t bestDist = 0;
+    for (int d = 0; d < 4; d++)
+    {
+        int nx, ny;
+        if (d == bannedDir || !Neighbor(game, walls, head.x, head.y, d, nx, ny) || !CanEnter(game, hurdles, nx, ny))
+            continue;
+        int room = 0;
+        for (int e = 0; e < 4; e++)
+        {
+            int mx, my;
+            if (Neighbor(game, walls, nx, ny, e, mx, my) && CanEnter(game, hurdles, mx, my))
+                room++;
+        }
+        uint32_t dist = game.foodX >= 0 ? Heuristic(game, walls, nx, ny, game.foodX, game.foodY) : 0;
+        if (room > bestRoom || (room == bestRoom && dist < bestDist))
+        {
+            best = d;
+            bestRoom = room;
+            bestDist = dist;
+        }
+    }
+    return best >= 0 ? best : DirIndex(game.key);
+}
+
+// position of (x, y) along the cycle. serpentine over columns 1.. going down
+// the rows, then back up column 0. needs an even number of rows, so boards
+// with an odd height are walked with x and y swapped
+static uint32_t CycleIndex(const Autopilot &ap, int x, int y)
+{
+    int w = ap.width;
+    int h = ap.height;
+    if (ap.cycleTransposed)
+    {
+        std::swap(x, y);
+        std::swap(w, h);
+    }
+
+    uint32_t idx;
+    if (y == 0)
+        idx = (uint32_t)x;
+    else if (x == 0)
+        idx = (uint32_t)(w + (h - 1) * (w - 1) + (h - 1 - y));
+    else if (y % 2 == 1)
+        idx = (uint32_t)(w + (y - 1) * (w - 1) + (w - 1 - x));
+    else
+        idx = (uint32_t)(w + (y - 1) * (w - 1) + (x - 1));
+
+    if (ap.cycleReversed)
+        idx = (uint32_t)(w * h - 1) - idx;
+    return idx;
+}
+
+// the cycle only works while the body sits on it in order, tail to head
+static bool BodyInCycleOrder(const Autopilot &ap, const GameState &game)
+{
+    uint32_t n = (uint32_t)(ap.width * ap.height);
+    const SnakeBody &body = game.snake;
+    uint32_t tail = CycleIndex(ap, body.Tail().x, body.Tail().y);
+    uint32_t last = 0;
+    for (int i = body.Length() - 2; i >= 0; i--)
+    {
+        uint32_t d = (CycleIndex(ap, body.At(i).x, body.At(i).y) + n - tail) % n;
+        if (d <= last)
+            return false;
+        last = d;
+    }
+    return true;
+}
+
+static void CheckCycle(Autopilot &ap, const GameState &game)
+{
+    ap.cycleChecked = true;
+    ap.cycleUsable = false;
+
+    // hurdles sit on the cycle, and an odd by odd board has none
+    if (HurdlesActive(game) || (ap.width % 2 == 1 && ap.height % 2 == 1))
+        return;
+
+    ap.cycleTransposed = ap.height % 2 == 1;
+    for (int r = 0; r < 2 && !ap.cycleUsable; r++)
+    {
+        ap.cycleReversed = r == 1;
+        ap.cycleUsable = BodyInCycleOrder(ap, game);
+    }
+}
+
+// follows the cycle, cutting ahead when that can't skip past the food or
+// come too close to the tail. the body stays in cycle order, so the head
+// always has free cells in front of it until the board is full
+static int DecideCycle(Autopilot &ap, const GameState &game, int bannedDir)
+{
+    uint32_t n = (uint32_t)(ap.width * ap.height);
+    const Cell &head = game.snake.Head();
+    const Cell &tail = game.snake.Tail();
+    int length = game.snake.Length();
+    uint32_t h = CycleIndex(ap, head.x, head.y);
+    uint32_t toTail = (CycleIndex(ap, tail.x, tail.y) + n - h) % n;
+    if (toTail == 0)
+        toTail = n;
+    uint32_t toFood = n;
+    if (game.foodX >= 0)
+        toFood = (CycleIndex(ap, game.foodX, game.foodY) + n - h) % n;
+
+    // shortcuts only while the snake is short, and never to within 3 cells
+    // of the tail so growing on the way can't close the gap
+    uint32_t maxJump = 1;
+    if ((uint32_t)length < n / 2 && toTail > 4)
+        maxJump = std::min(toFood, toTail - 4);
+
+    bool walls = WallsActive(game);
+    bool hurdles = HurdlesActive(game);
+    int best = -1;
+    uint32_t bestJump = 0;
+    for (int d = 0; d < 4; d++)
+    {
+        int nx, ny;
+        if (d == bannedDir || !Neighbor(game, walls, head.x, head.y, d, nx, ny) || !CanEnter(game, hurdles, nx, ny))
+            continue;
+        uint32_t jump = (CycleIndex(ap, nx, ny) + n - h) % n;
+        if ((jump == 1 || jump <= maxJump) && jump > bestJump)
+        {
+            best = d;
+            bestJump = jump;
+        }
+    }
+    return best;
+}
+
+void ResetAutopilot(Autopilot &ap)
+{
+    ap.foodPath.clear();
+    ap.foodPos = 0;
+    ap.pathFoodX = -1;
+    ap.pathFoodY = -1;
+    ap.tailPath.clear();
+    ap.tailPos = 0;
+    ap.foodRetry = 0;
+    ap.expectedHead = {-1, -1};
+    ap.cycleChecked = false;
+}
+
+Input AutopilotDecide(Autopilot &ap, GameState &game)
+{
+    Input input;
+    if (ap.mode == AUTOPILOT_OFF || game.gameOver || game.snake.Length() == 0)
+        return input;
+
+    Prepare(ap, game);
+    ap.spent = 0;
+    const Cell head = game.snake.Head();
+    if (head.x != ap.expectedHead.x || head.y != ap.expectedHead.y)
+        ResetAutopilot(ap);
+
+    int bannedDir = opposite[DirIndex(game.key)];
+    int d = -1;
+    if (ap.mode == AUTOPILOT_CYCLE)
+    {
+        if (!ap.cycleChecked)
+            CheckCycle(ap, game);
+        if (ap.cycleUsable)
+            d = DecideCycle(ap, game, bannedDir);
+    }
+    if (d < 0)
+        d = DecidePath(ap, game, bannedDir);
+
+    int nx, ny;
+    if (Neighbor(game, WallsActive(game), head.x, head.y, d, nx, ny))
+        ap.expectedHead = {nx, ny};
+    else
+        ap.expectedHead = {-1, -1};
+    input.key = dirKeys[d];
+    return input;
+}
+
+const char *AutopilotModeName(AutopilotMode mode)
+{
+    switch (mode)
+    {
+    case AUTOPILOT_PATH:
+        return "Pathfind";
+    case AUTOPILOT_CYCLE:
+        return "Cycle";
+    default:
+        return "Off";
+    }
+}
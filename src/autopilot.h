@@ -0,0 +1,67 @@
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "game.h"
+
+enum AutopilotMode
+{
+    AUTOPILOT_OFF = 0,
+    AUTOPILOT_PATH,  // shortest path to the food, chases its own tail when that isn't safe
+    AUTOPILOT_CYCLE  // hamiltonian cycle with shortcuts, always fills the board
+};
+
+// a bot that drives the game through the normal Input path. everything it
+// needs is kept here and reused, so after the first decision on a board it
+// doesn't allocate, and all searches of one decision together expand at most
+// searchBudget cells so a decision stays under a millisecond on huge boards
+struct Autopilot
+{
+    AutopilotMode mode = AUTOPILOT_OFF;
+    int searchBudget = 6000;
+    int spent = 0; // expansions used by the current decision
+
+    // scratch sized to the board
+    int width = 0;
+    int height = 0;
+    uint32_t searchGen = 0;
+    uint32_t markGen = 0;
+    std::vector<uint32_t> closed;     // searchGen << 2 | direction the search entered the cell with
+    std::vector<uint32_t> marks;      // cells of the imagined snake in the safety check
+    std::vector<uint32_t> buckets[4]; // open cells by f, as cell << 2 | direction
+    std::vector<Cell> found;
+    std::vector<Cell> stretched;
+
+    // paths being followed, reused tick after tick. the food path until the
+    // food moves, the tail path while the food can't be had safely
+    std::vector<Cell> foodPath;
+    size_t foodPos = 0;
+    int pathFoodX = -1;
+    int pathFoodY = -1;
+    std::vector<Cell> tailPath;
+    size_t tailPos = 0;
+    int foodRetry = 0; // ticks until the food is looked for again after a failed try
+
+    // where the head should be on the next decision, anything else means the
+    // game was reset, loaded or changed level and cached state is stale
+    Cell expectedHead = {-1, -1};
+
+    // hamiltonian cycle over the board, serpentine rows (columns when the
+    // height is odd), walked forwards or backwards to match the snake
+    bool cycleChecked = false;
+    bool cycleUsable = false;
+    bool cycleTransposed = false;
+    bool cycleReversed = false;
+};
+
+// drops cached paths, call after anything moves the snake outside of Step
+void ResetAutopilot(Autopilot &ap);
+
+// the input for the next tick
+Input AutopilotDecide(Autopilot &ap, GameState &game);
+
+const char *AutopilotModeName(AutopilotMode mode);
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef FREECELLS_H
+#define FREECELLS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// set of empty board cells (cell id = y * width + x) as one bit per cell plus
+// a fenwick tree of how many free cells each 64 cell word holds. add and
+// remove are O(log n) and Select picks the n-th free cell in board order,
+// so which cell a random number lands on depends only on what is free and
+// not on the order cells were freed in. that keeps games that are restored
+// from a save or a replay keyframe on exactly the same track
+struct FreeCellIndex
+{
+    int cellCount = 0;
+    int freeCount = 0;
+    std::vector<uint64_t> bits; // 1 = free
+    std::vector<int32_t> tree;  // 1-based fenwick tree over the words of bits
+
+    // every cell starts out occupied
+    void Resize(int cells)
+    {
+        cellCount = cells;
+        freeCount = 0;
+        bits.assign(((size_t)cells + 63) / 64, 0);
+        tree.assign(bits.size() + 1, 0);
+    }
+
+    int Count() const
+    {
+        return freeCount;
+    }
+
+    bool Contains(int id) const
+    {
+        return (bits[id >> 6] >> (id & 63)) & 1;
+    }
+
+    // bulk fill, call RebuildCounts once all cells are marked
+    void MarkFree(int id)
+    {
+        bits[id >> 6] |= 1ull << (id & 63);
+    }
+
+    void RebuildCounts()
+    {
+        freeCount = 0;
+        for (size_t i = 1; i < tree.size(); i++)
+            tree[i] = 0;
+        for (size_t w = 0; w < bits.size(); w++)
+        {
+            int n = __builtin_popcountll(bits[w]);
+            freeCount += n;
+            size_t i = w + 1;
+            tree[i] += n;
+            size_t parent = i + (i & (0 - i));
+            if (parent < tree.size())
+                tree[parent] += tree[i];
+        }
+    }
+
+    void Add(int id)
+    {
+        if (Contains(id))
+            return;
+        bits[id >> 6] |= 1ull << (id & 63);
+        UpdateCount(id >> 6, 1);
+    }
+
+    void Remove(int id)
+    {
+        if (!Contains(id))
+            return;
+        bits[id >> 6] &= ~(1ull << (id & 63));
+        UpdateCount(id >> 6, -1);
+    }
+
+    // id of the free cell with the given rank, 0 <= rank < Count()
+    int Select(int rank) const
+    {
+        size_t pos = 0;
+        size_t step = 1;
+        while (step * 2 < tree.size())
+            step *= 2;
+        for (; step > 0; step >>= 1)
+        {
+            if (pos + step < tree.size() && tree[pos + step] <= rank)
+            {
+                pos += step;
+                rank -= tree[pos];
+            }
+        }
+
+        // pos is now the word holding it, drop the lower free bits
+        uint64_t word = bits[pos];
+        for (int i = 0; i < rank; i++)
+            word &= word - 1;
+        return (int)(pos * 64 + __builtin_ctzll(word));
+    }
+
+    void UpdateCount(size_t word, int delta)
+    {
+        freeCount += delta;
+        for (size_t i = word + 1; i < tree.size(); i += i & (0 - i))
+            tree[i] += delta;
+    }
+};
+
+#endif
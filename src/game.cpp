@@ -0,0 +1,414 @@
+#include "game.h"
+
+#include <utility>
+
+// splitmix64, small and fast, and the whole state fits in one integer
+static uint64_t NextRandom(GameState &game)
+{
+    uint64_t z = (game.rngState += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void SeedRandom(GameState &game, uint64_t seed)
+{
+    game.rngState = seed;
+}
+
+// same contract as raylib's GetRandomValue, min and max are both included
+int RandomValue(GameState &game, int min, int max)
+{
+    if (max < min)
+    {
+        int tmp = min;
+        min = max;
+        max = tmp;
+    }
+    uint64_t range = (uint64_t)((int64_t)max - min) + 1;
+    return (int)(min + (int64_t)(NextRandom(game) % range));
+}
+
+bool WallsActive(const GameState &game)
+{
+    if (game.currentMode == STORY)
+        return game.level && game.level->walls;
+    return (game.currentMode == NORMAL || game.currentMode == HARD || game.currentMode == MAZE);
+}
+
+bool HurdlesActive(const GameState &game)
+{
+    return (game.currentMode == HARD || game.currentMode == MAZE || (game.currentMode == STORY && !game.hurdles.empty()));
+}
+
+const LevelSet &StoryLevels(const GameState &game)
+{
+    return game.levels ? *game.levels : DefaultLevels();
+}
+
+// puts the current level's obstacles on the board, taking the prebuilt one
+// when it is the right level and only building when it isn't
+void EnterLevel(GameState &game)
+{
+    const LevelDef *def = &HardLevel();
+    uint64_t seed = 0;
+    float density = 0.0f;
+    if (game.currentMode == STORY)
+        def = &StoryLevels(game).levels[game.storyLevel - 1];
+    else if (game.currentMode == MAZE)
+    {
+        def = &MazeLevel();
+        seed = game.mazeSeed;
+        density = game.mazeDensity;
+    }
+    int w = game.gridCountX;
+    int h = game.gridCountY;
+    if (game.level == def && game.levelSeed == seed && game.levelDensity == density && game.hurdleCells.width == w &&
+        game.hurdleCells.height == h)
+        return;
+
+    LevelLayout &next = game.nextLevel;
+    if (next.def != def || next.seed != seed || next.density != density || next.width != w || next.height != h)
+    {
+        if (game.currentMode == MAZE)
+            GenerateMaze(w, h, density, seed, w / 2, h / 2, next);
+        else
+            BuildLevel(*def, w, h, next);
+        next.def = def;
+    }
+
+    // the old layout stays in nextLevel, going back a level is free too
+    std::swap(game.hurdles, next.hurdles);
+    std::swap(game.hurdleCells, next.hurdleCells);
+    next.def = game.level;
+    next.seed = game.levelSeed;
+    next.density = game.levelDensity;
+    game.level = def;
+    game.levelSeed = seed;
+    game.levelDensity = density;
+}
+
+static bool PlacementFree(const GameState &game, bool hurdlesActive, int x, int y)
+{
+    return game.snakeCells.InBounds(x, y) && !IsTileBlocked(x, y, game, hurdlesActive);
+}
+
+// lays the snake out behind its head on free cells only. the body runs
+// straight back, and where a hurdle, the edge or itself is in the way it
+// steps aside and folds back the other way. a body that can't fit is cut
+// short. snakeCells is used as scratch, callers rebuild the occupancy after
+static void PlaceSnake(GameState &game, int length, int x, int y)
+{
+    if (game.snakeCells.width != game.gridCountX || game.snakeCells.height != game.gridCountY)
+        game.snakeCells.Resize(game.gridCountX, game.gridCountY);
+    else
+        game.snakeCells.ClearAll();
+    bool hurdlesActive = HurdlesActive(game);
+
+    // a head on a hurdle moves to the nearest free cell around it
+    for (int r = 1; !PlacementFree(game, hurdlesActive, x, y); r++)
+    {
+        if (r > game.gridCountX && r > game.gridCountY)
+            break;
+        bool found = false;
+        for (int oy = -r; oy <= r && !found; oy++)
+        {
+            for (int ox = -r; ox <= r && !found; ox++)
+            {
+                if ((ox == -r || ox == r || oy == -r || oy == r) && PlacementFree(game, hurdlesActive, x + ox, y + oy))
+                {
+                    x += ox;
+                    y += oy;
+                    found = true;
+                }
+            }
+        }
+    }
+
+    int dx = 0, dy = 0;
+    switch (game.key)
+    {
+    case 'R':
+        dx = -1;
+        break;
+    case 'L':
+        dx = 1;
+        break;
+    case 'U':
+        dy = 1;
+        break;
+    case 'D':
+        dy = -1;
+        break;
+    }
+    int sideX = dy, sideY = dx; // the way it steps when folding
+
+    game.snake.Clear();
+    game.snake.PushTail(x, y);
+    game.snakeCells.Set(x, y);
+    while (game.snake.Length() < length)
+    {
+        if (PlacementFree(game, hurdlesActive, x + dx, y + dy))
+        {
+            x += dx;
+            y += dy;
+        }
+        else if (PlacementFree(game, hurdlesActive, x + sideX, y + sideY))
+        {
+            x += sideX;
+            y += sideY;
+            dx = -dx;
+            dy = -dy;
+        }
+        else if (PlacementFree(game, hurdlesActive, x - sideX, y - sideY))
+        {
+            // the side ran out, fold towards the other one from here on
+            sideX = -sideX;
+            sideY = -sideY;
+            x += sideX;
+            y += sideY;
+            dx = -dx;
+            dy = -dy;
+        }
+        else
+        {
+            break;
+        }
+        game.snake.PushTail(x, y);
+        game.snakeCells.Set(x, y);
+    }
+}
+
+// marks every snake segment on the grid and collects the free cells,
+// used after the body is placed wholesale or the active hurdles change
+void RebuildOccupancy(GameState &game)
+{
+    if (game.snakeCells.width != game.gridCountX || game.snakeCells.height != game.gridCountY)
+        game.snakeCells.Resize(game.gridCountX, game.gridCountY);
+    else
+        game.snakeCells.ClearAll();
+
+    for (int i = 0; i < game.snake.Length(); i++)
+        game.snakeCells.Set(game.snake.At(i).x, game.snake.At(i).y);
+
+    bool hurdlesActive = HurdlesActive(game);
+    game.freeCells.Resize(game.gridCountX * game.gridCountY);
+    for (int y = 0; y < game.gridCountY; y++)
+    {
+        for (int x = 0; x < game.gridCountX; x++)
+        {
+            if (!IsTileBlocked(x, y, game, hurdlesActive))
+                game.freeCells.MarkFree(y * game.gridCountX + x);
+        }
+    }
+    game.freeCells.RebuildCounts();
+}
+
+// checks if a coordinate hits the snake or a wall
+bool IsTileBlocked(int x, int y, const GameState &game, bool hurdlesActive)
+{
+    if (game.snakeCells.Test(x, y))
+        return true;
+    return hurdlesActive && game.hurdleCells.Test(x, y);
+}
+
+// spawn food on a random free cell, false when the board is full
+bool SpawnFood(GameState &game)
+{
+    if (game.freeCells.Count() == 0)
+    {
+        game.foodX = -1;
+        game.foodY = -1;
+        return false;
+    }
+    int id = game.freeCells.Select(RandomValue(game, 0, game.freeCells.Count() - 1));
+    game.foodX = id % game.gridCountX;
+    game.foodY = id / game.gridCountX;
+    return true;
+}
+
+// resets game state
+void ResetGame(GameState &game, bool fullReset)
+{
+    if (fullReset)
+    {
+        game.gameOver = false;
+        game.gameWon = false;
+        game.deathCause = DEATH_NONE;
+        game.score = 0;
+        game.storyLevel = 1;
+        game.key = 'R';
+        game.moveTimer = 0.0f;
+        game.moveInterval = game.startInterval;
+        game.isLevelTransitioning = false;
+        game.transitionTimer = 0.0f;
+        if (game.currentMode == MAZE)
+            game.mazeSeed = NextRandom(game);
+    }
+
+    // reset snake to middle, or where the story level puts it, laid out
+    // behind the head so no two segments share a cell
+    EnterLevel(game);
+    int length = fullReset ? 4 : game.snake.Length();
+    int x = game.gridCountX / 2;
+    int y = game.gridCountY / 2;
+    if (game.currentMode == STORY)
+    {
+        LevelSpawn(*game.level, game.gridCountX, game.gridCountY, x, y);
+        if (fullReset)
+        {
+            game.key = game.level->spawnKey;
+            if (game.level->speed > 0.0f)
+                game.moveInterval = game.level->speed;
+        }
+    }
+    PlaceSnake(game, length, x, y);
+    RebuildOccupancy(game);
+
+    SpawnFood(game);
+}
+
+// advances the game by exactly one move
+int Step(GameState &game, Input input)
+{
+    if (game.gameOver)
+        return EVENT_NONE;
+
+    bool wallsActive = WallsActive(game);
+    bool hurdlesActive = HurdlesActive(game);
+
+    // prevent 180 degree turns
+    if (input.key == 'R' && game.key != 'L')
+        game.key = 'R';
+    else if (input.key == 'L' && game.key != 'R')
+        game.key = 'L';
+    else if (input.key == 'U' && game.key != 'D')
+        game.key = 'U';
+    else if (input.key == 'D' && game.key != 'U')
+        game.key = 'D';
+
+    int nextX = game.snake.Head().x;
+    int nextY = game.snake.Head().y;
+
+    switch (game.key)
+    {
+    case 'R':
+        nextX++;
+        break;
+    case 'L':
+        nextX--;
+        break;
+    case 'U':
+        nextY--;
+        break;
+    case 'D':
+        nextY++;
+        break;
+    }
+
+    // wall collision
+    if (nextX < 0 || nextX >= game.gridCountX || nextY < 0 || nextY >= game.gridCountY)
+    {
+        if (wallsActive)
+        {
+            game.gameOver = true;
+            game.deathCause = DEATH_WALL;
+            return EVENT_DIED;
+        }
+        else
+        {
+            // wrap around logic
+            if (nextX < 0)
+                nextX = game.gridCountX - 1;
+            if (nextX >= game.gridCountX)
+                nextX = 0;
+            if (nextY < 0)
+                nextY = game.gridCountY - 1;
+            if (nextY >= game.gridCountY)
+                nextY = 0;
+        }
+    }
+
+    // hurdle collision
+    if (hurdlesActive && game.hurdleCells.Test(nextX, nextY))
+    {
+        game.gameOver = true;
+        game.deathCause = DEATH_HURDLE;
+        return EVENT_DIED;
+    }
+
+    int events = EVENT_MOVED;
+    bool grows = (nextX == game.foodX && nextY == game.foodY);
+
+    // the tail cell frees up this tick unless the snake is growing,
+    // so moving into where the tail was is allowed
+    if (!grows)
+    {
+        const Cell &tail = game.snake.Tail();
+        game.snakeCells.Clear(tail.x, tail.y);
+        if (game.snakeCells.InBounds(tail.x, tail.y) && !(hurdlesActive && game.hurdleCells.Test(tail.x, tail.y)))
+            game.freeCells.Add(tail.y * game.gridCountX + tail.x);
+        game.snake.PopTail();
+    }
+    bool hitSelf = game.snakeCells.Test(nextX, nextY);
+
+    // move the head, the rest of the body stays where it is
+    game.snake.PushHead(nextX, nextY);
+    game.snakeCells.Set(nextX, nextY);
+    game.freeCells.Remove(nextY * game.gridCountX + nextX);
+
+    // food collision
+    if (grows)
+    {
+        game.score += 10;
+        if (game.moveInterval > game.minInterval)
+            game.moveInterval -= game.intervalStep; // slight speed up
+        events |= EVENT_ATE_FOOD;
+
+        // nowhere left to put food, the snake fills the board
+        if (!SpawnFood(game))
+        {
+            game.gameOver = true;
+            game.gameWon = true;
+            return events | EVENT_WON;
+        }
+    }
+
+    // self collision
+    if (hitSelf)
+    {
+        game.gameOver = true;
+        game.deathCause = DEATH_SELF;
+        return events | EVENT_DIED;
+    }
+
+    // handle story progression, a big enough score skips levels
+    if (game.currentMode == STORY && (events & EVENT_ATE_FOOD))
+    {
+        const LevelSet &levels = StoryLevels(game);
+        int nextLevel = game.storyLevel;
+        while (nextLevel < (int)levels.levels.size() && game.score >= levels.levels[nextLevel].score)
+            nextLevel++;
+
+        if (nextLevel > game.storyLevel)
+        {
+            game.storyLevel = nextLevel;
+            EnterLevel(game);
+
+            // respawn logic to prevent glitches on level change
+            int x, y;
+            LevelSpawn(*game.level, game.gridCountX, game.gridCountY, x, y);
+            game.key = game.level->spawnKey;
+            if (game.level->speed > 0.0f)
+                game.moveInterval = game.level->speed;
+            PlaceSnake(game, game.snake.Length(), x, y);
+            RebuildOccupancy(game);
+
+            // check hurdles before spawning food
+            SpawnFood(game);
+            events |= EVENT_LEVEL_UP;
+        }
+    }
+
+    return events;
+}
@@ -0,0 +1,140 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <cstdint>
+#include "occupancy.h"
+#include "snakebody.h"
+#include "freecells.h"
+#include "level.h"
+#include "maze.h"
+
+// difficulty levels
+enum GameMode
+{
+    EASY = 0,
+    NORMAL = 1,
+    HARD = 2,
+    STORY = 3,
+    MAZE = 4 // endless, on a freshly generated board every game
+};
+
+// color schemes, their palettes live with the drawing code
+enum Theme
+{
+    THEME_CLASSIC = 0,
+    THEME_DESERT,
+    THEME_COUNT
+};
+
+// why the last game ended
+enum DeathCause
+{
+    DEATH_NONE = 0, // still playing, or won
+    DEATH_WALL,
+    DEATH_SELF,
+    DEATH_HURDLE
+};
+
+// keeps track of everything happening in the game
+struct GameState
+{
+    int stateofgame = 0; // 0 = menu, 2 = playing
+    int menuOption = 1;
+
+    GameMode currentMode = NORMAL;
+    Theme theme = THEME_CLASSIC;
+    int storyLevel = 1;
+
+    bool gameOver = false;
+    bool gameWon = false; // snake filled the whole board
+    DeathCause deathCause = DEATH_NONE;
+    int score = 0;
+    int highscore = 0;
+
+    // board size in cells
+    int gridCountX = 0;
+    int gridCountY = 0;
+
+    // snake properties
+    SnakeBody snake;
+    int snakeX, snakeY;
+    char key = 'R';
+
+    // food pos
+    int foodX = 0;
+    int foodY = 0;
+
+    // speed control
+    float moveTimer = 0.0f;
+    float moveInterval = 0.1f;
+
+    // speed curve: every food takes intervalStep off until minInterval
+    float startInterval = 0.1f;
+    float intervalStep = 0.001f;
+    float minInterval = 0.05f;
+
+    // level switching
+    bool isLevelTransitioning = false;
+    float transitionTimer = 0.0f;
+    const float transitionDuration = 3.0f;
+
+    // story levels, the built in ones unless a level file was loaded
+    const LevelSet *levels = nullptr;
+
+    // obstacles of the level being played, and the next one built ahead of
+    // time so a level change only swaps buffers
+    const LevelDef *level = nullptr;
+    uint64_t levelSeed = 0;
+    float levelDensity = 0.0f;
+    std::vector<Cell> hurdles;
+    LevelLayout nextLevel;
+
+    // maze mode, the seed is drawn from the game's rng on every new game
+    float mazeDensity = 0.3f;
+    uint64_t mazeSeed = 0;
+
+    // which cells hold a snake segment or a hurdle, kept in sync every move
+    OccupancyGrid snakeCells;
+    OccupancyGrid hurdleCells;
+
+    // every cell food could go on right now
+    FreeCellIndex freeCells;
+
+    // save system
+    bool hasSaveFile = false;
+
+    // random generator, seeded once so runs can be replayed
+    uint64_t rngState = 0x9E3779B97F4A7C15ull;
+};
+
+// input for a single tick, key is 'R', 'L', 'U', 'D' or 0 for no turn
+struct Input
+{
+    char key = 0;
+};
+
+// things that happened during a tick, returned by Step as bit flags
+enum StepEvent
+{
+    EVENT_NONE = 0,
+    EVENT_MOVED = 1,
+    EVENT_ATE_FOOD = 2,
+    EVENT_LEVEL_UP = 4,
+    EVENT_DIED = 8,
+    EVENT_WON = 16
+};
+
+// simulation core, no raylib in here
+void SeedRandom(GameState &game, uint64_t seed);
+int RandomValue(GameState &game, int min, int max);
+bool WallsActive(const GameState &game);
+bool HurdlesActive(const GameState &game);
+const LevelSet &StoryLevels(const GameState &game);
+void EnterLevel(GameState &game);
+void RebuildOccupancy(GameState &game);
+bool IsTileBlocked(int x, int y, const GameState &game, bool hurdlesActive);
+bool SpawnFood(GameState &game);
+void ResetGame(GameState &game, bool fullReset);
+int Step(GameState &game, Input input);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef INPUTQUEUE_H
+#define INPUTQUEUE_H
+
+// turns pressed since the last tick, oldest first. each tick uses one, so a
+// quick right-then-down lands on two ticks in a row instead of losing the down
+struct InputQueue
+{
+    static const int capacity = 4;
+    char keys[capacity];
+    double pressedAt[capacity]; // when the key went down, for the latency stats
+    int first = 0;
+    int count = 0;
+
+    void Clear()
+    {
+        first = 0;
+        count = 0;
+    }
+
+    // newest presses are dropped once it is full, nobody turns 4 times in one tick
+    bool Push(char key, double time)
+    {
+        if (count == capacity)
+            return false;
+        int i = (first + count) % capacity;
+        keys[i] = key;
+        pressedAt[i] = time;
+        count++;
+        return true;
+    }
+
+    bool Pop(char &key, double &time)
+    {
+        if (count == 0)
+            return false;
+        key = keys[first];
+        time = pressedAt[first];
+        first = (first + 1) % capacity;
+        count--;
+        return true;
+    }
+
+    // most recent key still waiting, 0 if none
+    char Last() const
+    {
+        return count > 0 ? keys[(first + count - 1) % capacity] : 0;
+    }
+};
+
+#endif
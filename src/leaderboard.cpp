@@ -0,0 +1,456 @@
+#include "leaderboard.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include "persist.h"
+#include "savefile.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+static const uint16_t leaderboardVersion = 1;
+static const size_t logHeaderSize = 16;
+static const size_t recordSize = 33;
+
+typedef std::multiset<LeaderboardEntry, RanksAbove> ModeBoard;
+
+// what reading the log found
+enum LogState
+{
+    LOG_OK = 0,
+    LOG_MISSING,
+    LOG_BROKEN, // no valid header, nothing in it can be trusted
+    LOG_TORN,   // read fine up to a partial record at the end
+    LOG_FAILED  // the read itself failed, the records are still good
+};
+
+static void PutU8(std::string &out, uint32_t v)
+{
+    out.push_back((char)(v & 0xFF));
+}
+
+static void PutU16(std::string &out, uint32_t v)
+{
+    PutU8(out, v);
+    PutU8(out, v >> 8);
+}
+
+static void PutU32(std::string &out, uint32_t v)
+{
+    PutU16(out, v);
+    PutU16(out, v >> 16);
+}
+
+static void PutU64(std::string &out, uint64_t v)
+{
+    PutU32(out, (uint32_t)v);
+    PutU32(out, (uint32_t)(v >> 32));
+}
+
+static uint32_t GetU16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t GetU32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t GetU64(const unsigned char *p)
+{
+    return (uint64_t)GetU32(p) | ((uint64_t)GetU32(p + 4) << 32);
+}
+
+// an advisory lock on the lock file for as long as it lives, or none when it
+// would have to wait and wait is false. the log itself is never locked since
+// a compaction replaces it with a new file
+struct FileLock
+{
+    bool locked = false;
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+
+    FileLock(const std::string &path, bool exclusive, bool wait)
+    {
+#ifdef _WIN32
+        handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                             OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            return;
+        OVERLAPPED overlapped = {};
+        DWORD flags = (exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0) | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY);
+        locked = LockFileEx(handle, flags, 0, 1, 0, &overlapped) != 0;
+#else
+        fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+            return;
+        int result;
+        do
+            result = flock(fd, (exclusive ? LOCK_EX : LOCK_SH) | (wait ? 0 : LOCK_NB));
+        while (result != 0 && errno == EINTR);
+        locked = result == 0;
+#endif
+    }
+
+    ~FileLock()
+    {
+#ifdef _WIN32
+        if (handle == INVALID_HANDLE_VALUE)
+            return;
+        if (locked)
+        {
+            OVERLAPPED overlapped = {};
+            UnlockFileEx(handle, 0, 1, 0, &overlapped);
+        }
+        CloseHandle(handle);
+#else
+        if (fd < 0)
+            return;
+        if (locked)
+            flock(fd, LOCK_UN);
+        close(fd);
+#endif
+    }
+
+    FileLock(const FileLock &) = delete;
+    FileLock &operator=(const FileLock &) = delete;
+};
+
+static void PutRecord(std::string &out, const LeaderboardEntry &entry)
+{
+    size_t start = out.size();
+    PutU8(out, (uint32_t)entry.mode);
+    PutU32(out, (uint32_t)entry.score);
+    PutU32(out, (uint32_t)entry.length);
+    PutU32(out, entry.durationMs);
+    PutU64(out, (uint64_t)entry.date);
+    PutU64(out, entry.replaySeed);
+    PutU32(out, Crc32((const unsigned char *)out.data() + start, recordSize - 4));
+}
+
+static bool GetRecord(const unsigned char *p, LeaderboardEntry &entry)
+{
+    if (GetU32(p + recordSize - 4) != Crc32(p, recordSize - 4) || p[0] >= leaderboardModes)
+        return false;
+    entry.mode = (GameMode)p[0];
+    entry.score = (int32_t)GetU32(p + 1);
+    entry.length = (int32_t)GetU32(p + 5);
+    entry.durationMs = GetU32(p + 9);
+    entry.date = (int64_t)GetU64(p + 13);
+    entry.replaySeed = GetU64(p + 21);
+    return true;
+}
+
+static ModeBoard::iterator InsertEntry(Leaderboard &board, const LeaderboardEntry &entry)
+{
+    ModeBoard &top = board.modes[entry.mode];
+    if ((int)top.size() >= leaderboardSize && !RanksAbove()(entry, *top.rbegin()))
+        return top.end();
+    ModeBoard::iterator it = top.insert(entry);
+    if ((int)top.size() > leaderboardSize)
+    {
+        ModeBoard::iterator last = std::prev(top.end());
+        if (board.keepsReplays && last->replaySeed != 0)
+            board.droppedReplays.push_back(last->replaySeed);
+        top.erase(last);
+    }
+    return it;
+}
+
+bool InsertLeaderboardEntry(Leaderboard &board, const LeaderboardEntry &entry)
+{
+    if (entry.mode < 0 || entry.mode >= leaderboardModes)
+        return false;
+    return InsertEntry(board, entry) != board.modes[entry.mode].end();
+}
+
+int ExpectLeaderboardEntry(Leaderboard &board, const LeaderboardEntry &entry)
+{
+    if (entry.mode < 0 || entry.mode >= leaderboardModes)
+        return 0;
+    ModeBoard &top = board.modes[entry.mode];
+    ModeBoard::iterator it = InsertEntry(board, entry);
+    if (it == top.end())
+        return 0;
+    board.expected.push_back(entry);
+    return (int)std::distance(top.begin(), it) + 1;
+}
+
+static bool SameRun(const LeaderboardEntry &a, const LeaderboardEntry &b)
+{
+    return a.mode == b.mode && a.score == b.score && a.length == b.length && a.durationMs == b.durationMs &&
+           a.date == b.date && a.replaySeed == b.replaySeed;
+}
+
+// a record of a run that is on the board already, it's expected no more
+static bool TakeExpected(Leaderboard &board, const LeaderboardEntry &entry)
+{
+    for (size_t i = 0; i < board.expected.size(); i++)
+    {
+        if (SameRun(board.expected[i], entry))
+        {
+            board.expected.erase(board.expected.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ForgetLeaderboardEntry(Leaderboard &board, const LeaderboardEntry &entry)
+{
+    if (entry.mode < 0 || entry.mode >= leaderboardModes)
+        return;
+    TakeExpected(board, entry);
+    ModeBoard &top = board.modes[entry.mode];
+    for (ModeBoard::iterator it = top.lower_bound(entry); it != top.end() && !RanksAbove()(entry, *it); ++it)
+    {
+        if (SameRun(*it, entry))
+        {
+            top.erase(it);
+            break;
+        }
+    }
+    board.readOffset = 0;
+}
+
+// deletes the replays of runs the log no longer has on the board
+static void DropReplays(Leaderboard &board)
+{
+    for (uint64_t seed : board.droppedReplays)
+        remove(LeaderboardReplayPath(seed).c_str());
+    board.droppedReplays.clear();
+}
+
+// an empty board, apart from the runs still expected
+static void ClearBoard(Leaderboard &board)
+{
+    for (ModeBoard &top : board.modes)
+        top.clear();
+    for (const LeaderboardEntry &entry : board.expected)
+        InsertEntry(board, entry);
+    board.generation = 0;
+    board.readOffset = 0;
+    board.records = 0;
+}
+
+// reads the records board hasn't seen yet, all of them when the log was
+// compacted since. the caller holds the lock
+static LogState ReadLog(Leaderboard &board)
+{
+    FILE *f = fopen(board.path.c_str(), "rb");
+    if (!f)
+        return errno == ENOENT ? LOG_MISSING : LOG_FAILED;
+
+    unsigned char header[logHeaderSize];
+    bool ok = fread(header, 1, logHeaderSize, f) == logHeaderSize && memcmp(header, "SNKB", 4) == 0 &&
+              GetU16(header + 4) == leaderboardVersion && GetU16(header + 6) == recordSize;
+    ok = ok && fseek(f, 0, SEEK_END) == 0;
+    long size = ok ? ftell(f) : -1;
+    if (!ok || size < (long)logHeaderSize)
+    {
+        fclose(f);
+        return LOG_BROKEN;
+    }
+
+    uint64_t generation = GetU64(header + 8);
+    if (generation != board.generation || board.readOffset < logHeaderSize || (uint64_t)size < board.readOffset)
+    {
+        ClearBoard(board);
+        board.generation = generation;
+        board.readOffset = logHeaderSize;
+    }
+
+    // whole records in one read, a torn one at the end is left for the next compaction
+    size_t count = ((size_t)size - board.readOffset) / recordSize;
+    bool torn = ((size_t)size - board.readOffset) % recordSize != 0;
+    if (count > 0)
+    {
+        std::vector<unsigned char> data(count * recordSize);
+        ok = fseek(f, (long)board.readOffset, SEEK_SET) == 0 && fread(data.data(), 1, data.size(), f) == data.size();
+        if (ok)
+        {
+            LeaderboardEntry entry;
+            for (size_t i = 0; i < count; i++)
+            {
+                if (GetRecord(&data[i * recordSize], entry) && !TakeExpected(board, entry))
+                    InsertEntry(board, entry);
+            }
+            board.readOffset += count * recordSize;
+            board.records += count;
+        }
+    }
+    fclose(f);
+    DropReplays(board);
+    if (!ok)
+        return LOG_FAILED;
+    return torn ? LOG_TORN : LOG_OK;
+}
+
+bool LoadLeaderboard(Leaderboard &board, const char *path, const char *lockPath)
+{
+    board.path = path;
+    board.lockPath = lockPath;
+    board.expected.clear();
+    ClearBoard(board);
+
+    FileLock lock(board.lockPath, false, true);
+    LogState state = ReadLog(board);
+    return state != LOG_BROKEN && state != LOG_FAILED;
+}
+
+bool RefreshLeaderboard(Leaderboard &board)
+{
+    FileLock lock(board.lockPath, false, false);
+    if (!lock.locked)
+        return false;
+    LogState state = ReadLog(board);
+    return state == LOG_OK || state == LOG_TORN;
+}
+
+std::string EncodeLeaderboardLog(const std::vector<LeaderboardEntry> &entries, uint64_t generation)
+{
+    std::string out;
+    out.reserve(logHeaderSize + entries.size() * recordSize);
+    out.append("SNKB", 4);
+    PutU16(out, leaderboardVersion);
+    PutU16(out, (uint32_t)recordSize);
+    PutU64(out, generation);
+    for (const LeaderboardEntry &entry : entries)
+        PutRecord(out, entry);
+    return out;
+}
+
+// replaces the log with what's on the board, under the lock and after
+// catching up, so nothing another instance added is lost
+static bool CompactLog(Leaderboard &board)
+{
+    std::vector<LeaderboardEntry> entries;
+    for (const ModeBoard &top : board.modes)
+        entries.insert(entries.end(), top.begin(), top.end());
+
+    // a new log the others can't mistake for the one they were reading
+    uint64_t generation = board.generation + 1;
+    if (generation < (uint64_t)time(nullptr))
+        generation = (uint64_t)time(nullptr);
+    if (!WriteFileAtomic(board.path, EncodeLeaderboardLog(entries, generation)))
+        return false;
+    board.generation = generation;
+    board.readOffset = logHeaderSize + entries.size() * recordSize;
+    board.records = entries.size();
+    return true;
+}
+
+static bool AppendRecord(Leaderboard &board, const LeaderboardEntry &entry)
+{
+    std::string record;
+    PutRecord(record, entry);
+    FILE *f = fopen(board.path.c_str(), "ab");
+    if (!f)
+        return false;
+
+    bool ok = fwrite(record.data(), 1, record.size(), f) == record.size();
+    ok = (fflush(f) == 0) && ok;
+#ifdef _WIN32
+    ok = (_commit(_fileno(f)) == 0) && ok;
+#else
+    ok = (fsync(fileno(f)) == 0) && ok;
+#endif
+    ok = (fclose(f) == 0) && ok;
+    if (ok)
+    {
+        board.readOffset += recordSize;
+        board.records++;
+    }
+    return ok;
+}
+
+// puts entry on a board that has just read the log under the lock, then
+// writes its replay and gets it into the log. the rank, or -1 when the log
+// wasn't written
+static int CommitEntry(Leaderboard &board, LogState state, const LeaderboardEntry &entry, const std::string &replay)
+{
+    ModeBoard &top = board.modes[entry.mode];
+    ModeBoard::iterator it = InsertEntry(board, entry);
+    int rank = it == top.end() ? 0 : (int)std::distance(top.begin(), it) + 1;
+    std::string replayPath = LeaderboardReplayPath(entry.replaySeed);
+    bool keepReplay = rank > 0 && !replay.empty();
+    if (keepReplay && !WriteFileAtomic(replayPath, replay))
+        keepReplay = false;
+
+    // a missing, broken or torn log is written anew from the board, and so
+    // is a long one once every record in it has been read. after a failed
+    // read the board may be missing runs, so the run is only appended
+    bool compact = state == LOG_MISSING || state == LOG_BROKEN || state == LOG_TORN ||
+                   (state == LOG_OK && board.records + 1 >= board.compactAt);
+    bool ok = compact ? CompactLog(board) : AppendRecord(board, entry);
+    if (ok)
+    {
+        DropReplays(board);
+        return rank;
+    }
+
+    // the run isn't anywhere the others can see it, and whatever it pushed
+    // off is still on the board. the next read starts over from the log
+    if (keepReplay)
+        remove(replayPath.c_str());
+    board.droppedReplays.clear();
+    board.readOffset = 0;
+    return -1;
+}
+
+int AddLeaderboardEntry(Leaderboard &board, const LeaderboardEntry &entry, const std::string &replay)
+{
+    if (entry.mode < 0 || entry.mode >= leaderboardModes)
+        return 0;
+    FileLock lock(board.lockPath, true, true);
+    if (!lock.locked)
+        return -1;
+    return CommitEntry(board, ReadLog(board), entry, replay);
+}
+
+int ImportLegacyHighscore(Leaderboard &board, const char *path, GameMode mode)
+{
+    FileLock lock(board.lockPath, true, true);
+    if (!lock.locked)
+        return -1;
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0; // never there, or another instance took it
+    LeaderboardEntry entry;
+    entry.mode = mode;
+    entry.date = (int64_t)time(nullptr);
+    bool found = fscanf(f, "%d", &entry.score) == 1 && entry.score > 0;
+    fclose(f);
+
+    int rank = found ? CommitEntry(board, ReadLog(board), entry, std::string()) : 0;
+    if (rank >= 0)
+        remove(path);
+    return rank;
+}
+
+int LeaderboardBest(const Leaderboard &board, GameMode mode)
+{
+    const ModeBoard &top = board.modes[mode];
+    return top.empty() ? 0 : top.begin()->score;
+}
+
+std::string LeaderboardReplayPath(uint64_t replaySeed)
+{
+    char path[48];
+    snprintf(path, sizeof(path), "best_%016llx.replay", (unsigned long long)replaySeed);
+    return path;
+}
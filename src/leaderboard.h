@@ -0,0 +1,121 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+#include "game.h"
+
+// best runs of every mode, shared by all game instances on the machine.
+// finished runs are appended to a log, and the log is compacted down to the
+// entries still on the board once it has grown enough. every read and write
+// holds a lock on a separate file, so one instance can compact while others
+// append and nobody loses a run
+//
+// log layout, all integers little endian
+//
+//   header (16 bytes)
+//     char[4] magic "SNKB"
+//     u16     version
+//     u16     record size
+//     u64     generation, bumped by every compaction
+//   records (33 bytes each)
+//     u8 mode, i32 score, u32 length, u32 duration ms, i64 date (unix time),
+//     u64 replay seed (0 when the run wasn't recorded), u32 crc32 of the rest
+//
+// a record torn by a crash is left out and gone after the next compaction
+const char leaderboardPath[] = "leaderboard.log";
+const char leaderboardLockPath[] = "leaderboard.lock";
+const int leaderboardModes = MAZE + 1;
+const int leaderboardSize = 100; // entries kept per mode
+
+struct LeaderboardEntry
+{
+    GameMode mode = NORMAL;
+    int score = 0;
+    int length = 0;
+    uint32_t durationMs = 0;
+    int64_t date = 0;
+    uint64_t replaySeed = 0;
+};
+
+// higher score first, then the faster run, then the earlier one
+struct RanksAbove
+{
+    bool operator()(const LeaderboardEntry &a, const LeaderboardEntry &b) const
+    {
+        if (a.score != b.score)
+            return a.score > b.score;
+        if (a.durationMs != b.durationMs)
+            return a.durationMs < b.durationMs;
+        return a.date < b.date;
+    }
+};
+
+struct Leaderboard
+{
+    std::string path;
+    std::string lockPath;
+    std::multiset<LeaderboardEntry, RanksAbove> modes[leaderboardModes];
+
+    // how far into the log this copy has read
+    uint64_t generation = 0;
+    uint64_t readOffset = 0;
+    size_t records = 0;
+
+    size_t compactAt = 4096; // records in the log before it gets compacted
+
+    // the copy that appends the runs also keeps their replays, it deletes the
+    // replay of a run that drops off the board once the log agrees
+    bool keepsReplays = false;
+    std::vector<uint64_t> droppedReplays; // replay seeds of runs pushed off
+
+    // runs put on this board ahead of their records, which another thread
+    // is appending. reading the record back doesn't count the run twice
+    std::vector<LeaderboardEntry> expected;
+};
+
+// sorts entry into its mode's top entries in memory only, O(log n). false
+// when it didn't make the board
+bool InsertLeaderboardEntry(Leaderboard &board, const LeaderboardEntry &entry);
+
+// reads the whole log, a missing log is an empty board
+bool LoadLeaderboard(Leaderboard &board, const char *path, const char *lockPath);
+
+// picks up runs appended since the last read. never waits for the lock, false
+// when someone else held it (or the read failed), try again later
+bool RefreshLeaderboard(Leaderboard &board);
+
+// appends a finished run to the log, catching up on the others' runs first
+// and compacting when due. waits for the lock and the disk. when the run
+// makes the board and replay isn't empty, the replay is written next to it
+// before the record, so nobody finds the run without its replay. returns the
+// run's rank, 0 when it didn't make it, -1 when the log couldn't be written
+int AddLeaderboardEntry(Leaderboard &board, const LeaderboardEntry &entry, const std::string &replay);
+
+// turns the score an older version kept alone in path into a run of mode.
+// the file is read and removed under the lock, and only once the run is in
+// the log, so two instances starting together import it once. returns like
+// AddLeaderboardEntry, 0 as well when there was nothing to import
+int ImportLegacyHighscore(Leaderboard &board, const char *path, GameMode mode);
+
+// puts a run on the board right away while another Leaderboard appends it,
+// see expected. returns its rank here, 0 when it didn't make it
+int ExpectLeaderboardEntry(Leaderboard &board, const LeaderboardEntry &entry);
+
+// takes back an expected run the appending side didn't get on the board.
+// the next refresh reads the whole log again, for runs it had pushed off
+void ForgetLeaderboardEntry(Leaderboard &board, const LeaderboardEntry &entry);
+
+// best score of a mode, 0 for an empty board
+int LeaderboardBest(const Leaderboard &board, GameMode mode);
+
+// a whole log holding entries, what a compaction writes
+std::string EncodeLeaderboardLog(const std::vector<LeaderboardEntry> &entries, uint64_t generation);
+
+// where the replay of a run on the board is kept
+std::string LeaderboardReplayPath(uint64_t replaySeed);
+
+#endif
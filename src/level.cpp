@@ -0,0 +1,504 @@
+#include "level.h"
+#include "savefile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+static const size_t levelHeaderSize = 16;
+
+// corner hooks and the barrier pair in the middle, the layout hard mode and
+// the last story level have always used
+static const char classicMap[] =
+    "map\n"
+    "###...............###\n"
+    "#...................#\n"
+    "#...................#\n"
+    ".....................\n"
+    ".....................\n"
+    ".....................\n"
+    ".......#######.......\n"
+    ".....................\n"
+    ".....................\n"
+    ".....................\n"
+    ".....................\n"
+    ".......#######.......\n"
+    ".....................\n"
+    ".....................\n"
+    ".....................\n"
+    "#...................#\n"
+    "#...................#\n"
+    "###...............###\n";
+
+static const char defaultStory[] =
+    "level Open field\n"
+    "walls off\n"
+    "score 0\n"
+    "\n"
+    "level Walled in\n"
+    "walls on\n"
+    "score 50\n"
+    "\n"
+    "level Hurdles\n"
+    "walls on\n"
+    "score 100\n";
+
+static const char hardBoard[] =
+    "level Hard\n"
+    "walls on\n";
+
+static const char mazeBoard[] =
+    "level Maze\n"
+    "walls on\n";
+
+static LevelSet BuiltinSet(const std::string &text)
+{
+    LevelSet set;
+    std::string error;
+    if (!ParseLevels(text, set, error))
+    {
+        fprintf(stderr, "built in levels: %s\n", error.c_str());
+        abort();
+    }
+    return set;
+}
+
+const LevelSet &DefaultLevels()
+{
+    static const LevelSet set = BuiltinSet(std::string(defaultStory) + classicMap);
+    return set;
+}
+
+const LevelDef &HardLevel()
+{
+    static const LevelSet set = BuiltinSet(std::string(hardBoard) + classicMap);
+    return set.levels[0];
+}
+
+const LevelDef &MazeLevel()
+{
+    static const LevelSet set = BuiltinSet(mazeBoard);
+    return set.levels[0];
+}
+
+static bool IsMapRow(const std::string &line)
+{
+    if (line.empty())
+        return false;
+    for (char c : line)
+    {
+        if (c != '.' && c != '#')
+            return false;
+    }
+    return true;
+}
+
+static bool ParseInt(const char *text, int &value)
+{
+    char *end;
+    long v = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || v < -1000000000L || v > 1000000000L)
+        return false;
+    value = (int)v;
+    return true;
+}
+
+// the rules a level set follows before a game gets it, whether it was just
+// parsed or came out of the cache
+static bool CheckLevels(const LevelSet &set, std::string &error)
+{
+    for (size_t i = 0; i < set.levels.size(); i++)
+    {
+        const LevelDef &def = set.levels[i];
+        std::string bad = "level " + std::to_string(i + 1) + ": ";
+        if (def.spawnX != -1 || def.spawnY != -1)
+        {
+            if (def.spawnX < 0 || def.spawnX >= def.mapWidth || def.spawnY < 0 || def.spawnY >= def.mapHeight)
+            {
+                error = bad + "spawn is outside the map";
+                return false;
+            }
+            size_t cell = (size_t)def.spawnY * def.mapWidth + def.spawnX;
+            if ((def.map[cell >> 3] >> (cell & 7)) & 1)
+            {
+                error = bad + "spawn is on a hurdle";
+                return false;
+            }
+        }
+        if (i > 0 && def.score < set.levels[i - 1].score)
+        {
+            error = bad + "score is lower than the level before";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseLevels(const std::string &text, LevelSet &set, std::string &error)
+{
+    set.levels.clear();
+    LevelDef *level = nullptr;
+    bool inMap = false;
+    int lineNo = 0;
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string line = text.substr(pos, end - pos);
+        pos = end + 1;
+        lineNo++;
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+            line.pop_back();
+
+        if (inMap && IsMapRow(line))
+        {
+            if (level->mapHeight > 0 && (int)line.size() != level->mapWidth)
+            {
+                error = "line " + std::to_string(lineNo) + ": map rows differ in width";
+                return false;
+            }
+            level->mapWidth = (int)line.size();
+            size_t first = (size_t)level->mapHeight * level->mapWidth;
+            level->mapHeight++;
+            level->map.resize(((size_t)level->mapHeight * level->mapWidth + 7) / 8, 0);
+            for (int x = 0; x < level->mapWidth; x++)
+            {
+                if (line[x] == '#')
+                    level->map[(first + x) >> 3] |= (uint8_t)(1 << ((first + x) & 7));
+            }
+            continue;
+        }
+        inMap = false;
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t space = line.find(' ');
+        std::string word = line.substr(0, space);
+        std::string rest = space == std::string::npos ? "" : line.substr(space + 1);
+        std::string bad = "line " + std::to_string(lineNo) + ": ";
+
+        if (word == "level")
+        {
+            if ((int)set.levels.size() >= maxLevels)
+            {
+                error = bad + "too many levels";
+                return false;
+            }
+            set.levels.emplace_back();
+            level = &set.levels.back();
+            level->name = rest;
+            continue;
+        }
+        if (!level)
+        {
+            error = bad + "expected level";
+            return false;
+        }
+
+        if (word == "walls" && (rest == "on" || rest == "off"))
+            level->walls = rest == "on";
+        else if (word == "score")
+        {
+            if (!ParseInt(rest.c_str(), level->score) || level->score < 0)
+            {
+                error = bad + "score is a whole number, 0 or more";
+                return false;
+            }
+        }
+        else if (word == "speed")
+        {
+            char *endp;
+            level->speed = strtof(rest.c_str(), &endp);
+            if (endp == rest.c_str() || *endp != '\0' || !(level->speed > 0.0f && level->speed <= 1.0f))
+            {
+                error = bad + "speed is a move interval between 0 and 1 seconds";
+                return false;
+            }
+        }
+        else if (word == "spawn")
+        {
+            char key;
+            if (sscanf(rest.c_str(), "%d %d %c", &level->spawnX, &level->spawnY, &key) != 3 ||
+                (key != 'R' && key != 'L' && key != 'U' && key != 'D'))
+            {
+                error = bad + "spawn takes x, y and one of R L U D";
+                return false;
+            }
+            level->spawnKey = key;
+        }
+        else if (word == "map" && rest.empty() && level->mapHeight == 0)
+            inMap = true;
+        else
+        {
+            error = bad + "can't read \"" + line + "\"";
+            return false;
+        }
+    }
+
+    if (set.levels.empty())
+    {
+        error = "no levels";
+        return false;
+    }
+    if (!CheckLevels(set, error))
+        return false;
+    set.crc = LevelSetCrc(set);
+    return true;
+}
+
+static void PutU8(std::string &out, uint32_t v)
+{
+    out.push_back((char)(v & 0xFF));
+}
+
+static void PutU16(std::string &out, uint32_t v)
+{
+    PutU8(out, v);
+    PutU8(out, v >> 8);
+}
+
+static void PutU32(std::string &out, uint32_t v)
+{
+    PutU16(out, v);
+    PutU16(out, v >> 16);
+}
+
+static uint32_t GetU16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t GetU32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// the level count and the levels, the part of the cache payload after the text's size and crc
+static void PutLevels(std::string &payload, const LevelSet &set)
+{
+    PutU32(payload, (uint32_t)set.levels.size());
+    for (const LevelDef &def : set.levels)
+    {
+        std::string name = def.name.substr(0, 0xFFFF);
+        PutU16(payload, (uint32_t)name.size());
+        payload += name;
+        PutU8(payload, def.walls);
+        PutU8(payload, (unsigned char)def.spawnKey);
+        PutU32(payload, (uint32_t)def.score);
+        uint32_t speedBits;
+        memcpy(&speedBits, &def.speed, sizeof(speedBits));
+        PutU32(payload, speedBits);
+        PutU32(payload, (uint32_t)def.spawnX);
+        PutU32(payload, (uint32_t)def.spawnY);
+        PutU32(payload, (uint32_t)def.mapWidth);
+        PutU32(payload, (uint32_t)def.mapHeight);
+        payload.append((const char *)def.map.data(), def.map.size());
+    }
+}
+
+uint32_t LevelSetCrc(const LevelSet &set)
+{
+    std::string levels;
+    PutLevels(levels, set);
+    return Crc32((const unsigned char *)levels.data(), levels.size());
+}
+
+std::string EncodeLevelCache(const LevelSet &set, const std::string &source)
+{
+    std::string payload;
+    PutU32(payload, (uint32_t)source.size());
+    PutU32(payload, Crc32((const unsigned char *)source.data(), source.size()));
+    PutLevels(payload, set);
+
+    std::string out;
+    out.reserve(levelHeaderSize + payload.size());
+    out.append("SNKL", 4);
+    PutU16(out, levelCacheVersion);
+    PutU16(out, levelHeaderSize);
+    PutU32(out, (uint32_t)payload.size());
+    PutU32(out, Crc32((const unsigned char *)payload.data(), payload.size()));
+    out += payload;
+    return out;
+}
+
+bool DecodeLevelCache(const unsigned char *data, size_t size, LevelSet &set, const std::string *source)
+{
+    if (size < levelHeaderSize || memcmp(data, "SNKL", 4) != 0)
+        return false;
+    if (GetU16(data + 4) != levelCacheVersion || GetU16(data + 6) != levelHeaderSize)
+        return false;
+    uint32_t payloadSize = GetU32(data + 8);
+    if (payloadSize != size - levelHeaderSize || payloadSize < 12)
+        return false;
+    const unsigned char *p = data + levelHeaderSize;
+    const unsigned char *end = p + payloadSize;
+    if (Crc32(p, payloadSize) != GetU32(data + 12))
+        return false;
+
+    // made from some other version of the text
+    if (source && (GetU32(p) != source->size() ||
+                   GetU32(p + 4) != Crc32((const unsigned char *)source->data(), source->size())))
+        return false;
+    uint32_t count = GetU32(p + 8);
+    p += 12;
+    if (count < 1 || count > (uint32_t)maxLevels)
+        return false;
+
+    LevelSet loaded;
+    loaded.levels.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        LevelDef &def = loaded.levels[i];
+        if (end - p < 2)
+            return false;
+        uint32_t nameSize = GetU16(p);
+        p += 2;
+        if ((size_t)(end - p) < nameSize + 26)
+            return false;
+        def.name.assign((const char *)p, nameSize);
+        p += nameSize;
+        def.walls = p[0] != 0;
+        def.spawnKey = (char)p[1];
+        def.score = (int)GetU32(p + 2);
+        uint32_t speedBits = GetU32(p + 6);
+        memcpy(&def.speed, &speedBits, sizeof(def.speed));
+        def.spawnX = (int)GetU32(p + 10);
+        def.spawnY = (int)GetU32(p + 14);
+        uint32_t mapWidth = GetU32(p + 18);
+        uint32_t mapHeight = GetU32(p + 22);
+        p += 26;
+
+        // the crc only says the bytes are the ones written, not that they make sense
+        if (def.spawnKey != 'R' && def.spawnKey != 'L' && def.spawnKey != 'U' && def.spawnKey != 'D')
+            return false;
+        if (def.score < 0 || (i > 0 && def.score < loaded.levels[i - 1].score))
+            return false;
+        if (!(def.speed == 0.0f || (def.speed > 0.0f && def.speed <= 1.0f)))
+            return false;
+        if (mapWidth > 65536 || mapHeight > 65536)
+            return false;
+        def.mapWidth = (int)mapWidth;
+        def.mapHeight = (int)mapHeight;
+        size_t mapBytes = ((size_t)mapWidth * mapHeight + 7) / 8;
+        if ((size_t)(end - p) < mapBytes)
+            return false;
+        def.map.assign(p, p + mapBytes);
+        p += mapBytes;
+    }
+    if (p != end)
+        return false;
+
+    // the same checks as the text gets, a cache from before one of them
+    // existed may not pass
+    std::string error;
+    if (!CheckLevels(loaded, error))
+        return false;
+    loaded.crc = LevelSetCrc(loaded);
+
+    set = std::move(loaded);
+    return true;
+}
+
+static bool ReadWholeFile(const char *path, std::string &out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    bool ok = fseek(f, 0, SEEK_END) == 0;
+    long size = ok ? ftell(f) : -1;
+    ok = size >= 0 && fseek(f, 0, SEEK_SET) == 0;
+    if (ok)
+    {
+        out.resize((size_t)size);
+        ok = fread(&out[0], 1, out.size(), f) == out.size();
+    }
+    fclose(f);
+    return ok;
+}
+
+bool LoadLevels(const char *textPath, const char *cachePath, LevelSet &set, std::string &cache, std::string &error)
+{
+    cache.clear();
+    std::string text, cached;
+    bool haveText = ReadWholeFile(textPath, text);
+    if (ReadWholeFile(cachePath, cached) &&
+        DecodeLevelCache((const unsigned char *)cached.data(), cached.size(), set, haveText ? &text : nullptr))
+        return true;
+
+    if (!haveText)
+    {
+        error = std::string("can't read ") + textPath;
+        return false;
+    }
+    if (!ParseLevels(text, set, error))
+    {
+        error = std::string(textPath) + " " + error;
+        return false;
+    }
+    cache = EncodeLevelCache(set, text);
+    return true;
+}
+
+static int FloorHalf(int v)
+{
+    return v >= 0 ? v / 2 : -((1 - v) / 2);
+}
+
+// where map coordinate c lands on a board of the given size, see level.h
+static int FitCoord(int c, int mapSize, int boardSize)
+{
+    int third = mapSize / 3;
+    if (c < third)
+        return c;
+    if (c >= mapSize - third)
+        return boardSize - (mapSize - c);
+    return FloorHalf(boardSize - mapSize) + c;
+}
+
+void BuildLevel(const LevelDef &def, int gridX, int gridY, LevelLayout &out)
+{
+    out.def = &def;
+    out.seed = 0;
+    out.density = 0.0f;
+    out.width = gridX;
+    out.height = gridY;
+    out.hurdles.clear();
+    if (out.hurdleCells.width != gridX || out.hurdleCells.height != gridY)
+        out.hurdleCells.Resize(gridX, gridY);
+    else
+        out.hurdleCells.ClearAll();
+
+    size_t i = 0;
+    for (int my = 0; my < def.mapHeight; my++)
+    {
+        int y = FitCoord(my, def.mapHeight, gridY);
+        for (int mx = 0; mx < def.mapWidth; mx++, i++)
+        {
+            if (!((def.map[i >> 3] >> (i & 7)) & 1))
+                continue;
+            int x = FitCoord(mx, def.mapWidth, gridX);
+            // a board smaller than the map folds cells onto each other or off the edge
+            if (!out.hurdleCells.InBounds(x, y) || out.hurdleCells.Test(x, y))
+                continue;
+            out.hurdleCells.Set(x, y);
+            out.hurdles.push_back({x, y});
+        }
+    }
+}
+
+void LevelSpawn(const LevelDef &def, int gridX, int gridY, int &x, int &y)
+{
+    if (def.spawnX < 0)
+    {
+        x = gridX / 2;
+        y = gridY / 2;
+        return;
+    }
+    x = FitCoord(def.spawnX, def.mapWidth, gridX);
+    y = FitCoord(def.spawnY, def.mapHeight, gridY);
+    x = x < 0 ? 0 : (x >= gridX ? gridX - 1 : x);
+    y = y < 0 ? 0 : (y >= gridY ? gridY - 1 : y);
+}
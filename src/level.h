@@ -0,0 +1,97 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "occupancy.h"
+#include "snakebody.h"
+
+// story levels are plain text, one block per level:
+//
+//   # comment
+//   level Walled in      starts a level, the rest of the line is its name
+//   walls on             on or off, off wraps around the edges
+//   score 50             score that reaches this level (ignored on the first)
+//   speed 0.08           optional, move interval when the level starts
+//   spawn 22 12 R        optional, head cell on the map and direction
+//   map                  optional hurdle bitmap, rows of '.' and '#' follow
+//   ###.........###
+//   #.............#
+//
+// a map is drawn once and fitted to any board size: cells in its left and
+// top thirds keep their distance to the left and top edge, cells in the
+// right and bottom thirds to the right and bottom edge, and the middle
+// third stays centered. without a spawn the snake starts mid board heading right
+//
+// the parsed levels are cached as "SNKL", version, header size, payload size,
+// crc32 of the payload, then the size and crc32 of the text it came from,
+// the level count and per level: u16 name length, name, u8 walls, u8 spawn key,
+// i32 score, f32 speed, i32 spawn x, i32 spawn y, u32 map width, u32 map height,
+// map bits row by row, lowest bit first
+const char levelFilePath[] = "levels/story.txt";
+const char levelCachePath[] = "levels/story.cache";
+const uint16_t levelCacheVersion = 2;
+const int maxLevels = 65535; // story level is two bytes in a save
+
+struct LevelDef
+{
+    std::string name;
+    bool walls = false;
+    int score = 0;
+    float speed = 0.0f; // 0 keeps the current speed
+    int spawnX = -1;     // map cell, -1 for mid board
+    int spawnY = -1;
+    char spawnKey = 'R';
+    int mapWidth = 0;
+    int mapHeight = 0;
+    std::vector<uint8_t> map; // one bit per map cell, set for a hurdle
+};
+
+struct LevelSet
+{
+    std::vector<LevelDef> levels;
+    uint32_t crc = 0; // LevelSetCrc, saves and replays name the set they were played on by it
+};
+
+// a level fitted to a board, cheap to swap into a game
+struct LevelLayout
+{
+    const LevelDef *def = nullptr;
+    uint64_t seed = 0; // generated boards only
+    float density = 0.0f;
+    int width = 0;
+    int height = 0;
+    std::vector<Cell> hurdles;
+    OccupancyGrid hurdleCells;
+};
+
+// the three story levels the game always had, the hard mode board and the
+// settings of maze mode, whose hurdles are generated instead
+const LevelSet &DefaultLevels();
+const LevelDef &HardLevel();
+const LevelDef &MazeLevel();
+
+// false with a "line N: ..." message for anything malformed
+bool ParseLevels(const std::string &text, LevelSet &set, std::string &error);
+
+// crc32 of the levels as the cache stores them, the same for a set however it
+// was loaded. whoever changes a loaded set updates its crc
+uint32_t LevelSetCrc(const LevelSet &set);
+
+std::string EncodeLevelCache(const LevelSet &set, const std::string &source);
+bool DecodeLevelCache(const unsigned char *data, size_t size, LevelSet &set, const std::string *source);
+
+// reads the cache when it was made from the current text, otherwise parses the
+// text and hands back a fresh cache to write in cache. a cache with no text
+// next to it is used as is. false when neither gives any levels
+bool LoadLevels(const char *textPath, const char *cachePath, LevelSet &set, std::string &cache, std::string &error);
+
+// fits def to a gridX by gridY board, reusing out's buffers
+void BuildLevel(const LevelDef &def, int gridX, int gridY, LevelLayout &out);
+
+// where def puts the head on a gridX by gridY board
+void LevelSpawn(const LevelDef &def, int gridX, int gridY, int &x, int &y);
+
+#endif
@@ -1,131 +1,331 @@
 #include <raylib.h>
+#include <rlgl.h>
 #include <stdlib.h>
 #include <string>
-#include <fstream>
 #include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <climits>
 #include <cmath>
+#include <ctime>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include "game.h"
+#include "persist.h"
+#include "savefile.h"
+#include "replay.h"
+#include "inputqueue.h"
+#include "profiler.h"
+#include "autopilot.h"
+#include "rewind.h"
+#include "arena.h"
+#include "alloccount.h"
+#include "leaderboard.h"
+#include "telemetry.h"
 
-// difficulty levels
-enum GameMode
+// globals (calculated later)
+int screenWidth;
+int screenHeight;
+const int cellSize = 40;
+int boardWidth, boardHeight;
+int gridCountX, gridCountY;
+int boardOffsetX, boardOffsetY;
+
+// every new game is recorded and written out when it ends
+const char lastReplayPath[] = "lastgame.replay";
+Replay recording;
+bool recordingActive = false;
+
+// arrow presses wait here until a tick uses them. the latency numbers are
+// key down to the tick that turned the snake, in ms
+InputQueue inputQueue;
+float lastInputLatency = 0.0f;
+float avgInputLatency = 0.0f;
+float maxInputLatency = 0.0f;
+
+// picked in the menu, steers instead of the arrow keys when on. its games
+// don't count for the leaderboard
+Autopilot autopilot;
+
+// best runs of every mode, shared with any other instance running. the menu
+// picks up their runs every leaderboardRefresh seconds
+Leaderboard leaderboard;
+Leaderboard diskLeaderboard; // the persistence worker's copy, it appends the runs
+std::mutex unrankedMutex;
+std::vector<LeaderboardEntry> unrankedRuns; // the worker couldn't rank these, the menu takes them back
+const double leaderboardRefresh = 2.0;
+double leaderboardCheckedAt = 0.0;
+const int leaderboardShown = 5; // top runs listed in the menu
+const char legacyHighscorePath[] = "highscore.txt";
+
+// the run being played. it only ends when the player leaves the game over
+// screen, until then a rewind can bring it back to life
+float runSeconds = 0.0f;
+uint32_t runTicks = 0;
+bool runAutopiloted = false;
+bool runEnded = false;
+
+// story levels from levels/story.txt. the level after the one being played
+// is built on a worker thread, during the countdown of a level change, so
+// reaching it only swaps buffers
+LevelSet storyLevels;
+std::future<LevelLayout> levelBuild;
+
+// hold backspace to scrub back through the last 30 seconds, play carries on
+// from wherever it is let go. works from the game over screen too
+const float rewindSpeed = 2.0f; // ticks scrubbed per tick of play
+RewindHistory rewindHistory;
+bool rewinding = false;
+float rewindCursor = 0.0f;
+
+// F3 shows fps, input lag and the frame profiler, F4 writes the profiled
+// frames out for chrome://tracing. the profiler only runs while shown
+const char traceFilePath[] = "profile_trace.json";
+bool showStats = false;
+
+// the menu, game over screen and level countdown only change on input or
+// once a second, so there the loop sleeps between input polls and draws
+// only when something on screen changed
+const float idleFrameTime = 1.0f / 30.0f;
+bool idleThrottle = true;
+uint64_t lastScreenKey = 0;
+
+// window of the offscreen benchmark
+const int offscreenWidth = 1280;
+const int offscreenHeight = 720;
+
+// the game ticks at a fixed rate while frames come as fast as the display
+// allows, so the snake is drawn between its last two tick positions.
+// tailFrom is where the tail was before the last tick, smoothMotion is off
+// after anything that teleports the snake (new game, load, level up)
+const int maxTicksPerFrame = 8;
+float frameTime = 0.0f;      // seconds since the last frame started
+double lastFrameStart = 0.0;
+Cell tailFrom = {0, 0};
+bool smoothMotion = false;
+
+// background, grid, hurdles and walls never change mid-game, so they are
+// drawn once into this texture and redrawn only when one of these changes
+RenderTexture2D boardLayer = {0};
+int boardLayerTheme = -1;
+int boardLayerMode = -1;
+int boardLayerLevel = -1;
+uint64_t boardLayerSeed = 0; // maze boards differ every game
+float boardLayerDensity = 0.0f;
+int boardLayerWidth = 0;
+int boardLayerHeight = 0;
+
+// snake and food sprites, rasterized once per theme into a single atlas so
+// the whole snake is sent as one stream of textured quads. each slot is two
+// cells wide so the apple stem fits above its cell
+enum SpriteSlot
 {
-    EASY = 0,
-    NORMAL = 1,
-    HARD = 2,
-    STORY = 3
+    SPRITE_BODY = 0,
+    SPRITE_HEAD_R,
+    SPRITE_HEAD_L,
+    SPRITE_HEAD_U,
+    SPRITE_HEAD_D,
+    SPRITE_FOOD,
+    SPRITE_COUNT
 };
+const int spriteSize = cellSize * 2;
+RenderTexture2D spriteAtlas = {0};
+int spriteAtlasTheme = -1;
 
-// keeps track of everything happening in the game
-struct GameState
+// colors of a theme, shared by the game and the arena view
+struct ThemeColors
 {
-    int stateofgame = 0; // 0 = menu, 2 = playing
-    int menuOption = 1;
-
-    GameMode currentMode = NORMAL;
-    std::string theme = "Classic";
-    int storyLevel = 1;
-
-    bool gameOver = false;
-    int score = 0;
-    int highscore = 0;
-
-    // snake properties
-    int snakeLength = 4;
-    int snakePosition[1024][2] = {0};
-    int snakeX, snakeY;
-    char key = 'R';
-
-    // food pos
-    int foodX = 0;
-    int foodY = 0;
-
-    // speed control
-    float moveTimer = 0.0f;
-    float moveInterval = 0.1f;
-    bool allowMove = false;
-
-    // level switching
-    bool isLevelTransitioning = false;
-    float transitionTimer = 0.0f;
-    const float transitionDuration = 3.0f;
+    const char *name;
+    Color bg;
+    Color grid;
+    Color snake;
+    Color food;
+    Color menuBg; // menu background and the frame around the board
+    Color menuBox;
+    Color menuSel;
+    Color menuText;
+};
 
-    // obstacles
-    int hurdles[100][2];
-    int hurdleCount = 0;
+// indexed by Theme
+const ThemeColors themeColors[THEME_COUNT] = {
+    {"Classic", {150, 180, 110, 255}, {100, 130, 90, 255}, {50, 70, 40, 255}, {200, 0, 0, 255},
+     {185, 205, 160, 255}, {160, 190, 140, 255}, {120, 150, 110, 255}, {60, 80, 50, 255}},
+    {"Desert", {255, 246, 199, 255}, {232, 223, 194, 255}, {15, 26, 51, 255}, {255, 79, 163, 255},
+     {240, 225, 185, 255}, {225, 210, 178, 255}, {25, 40, 75, 255}, {60, 45, 25, 255}}};
+
+// indexed by GameMode
+const char *modeMenuNames[] = {"Easy", "Normal", "Hard", "Story", "Maze"};
+const char *modeHudNames[] = {"EASY", "NORMAL", "HARD", "STORY", "MAZE"};
+const Color modeHudColors[] = {GREEN, ORANGE, RED, SKYBLUE, PURPLE};
+
+// menu and hud text is laid out ahead of time instead of every frame: fixed
+// lines are measured once at startup, the rest formatted into a fixed buffer
+// and measured again only when the value they show changes
+enum FixedText
+{
+    TEXT_REWIND = 0,
+    TEXT_GET_READY,
+    TEXT_YOU_WIN,
+    TEXT_GAME_OVER,
+    TEXT_ESC_HINT,
+    TEXT_RESTART_HINT,
+    TEXT_REWIND_HINT,
+    TEXT_COUNT
+};
 
-    // save system
-    bool hasSaveFile = false;
+struct TextLabel
+{
+    char text[96];
+    int fontSize;
+    int width;
+    long long key; // the value text was made from
+    bool ready;
 };
 
-// globals (calculated later)
-int screenWidth;
-int screenHeight;
-const int cellSize = 40;
-int boardWidth, boardHeight;
-int gridCountX, gridCountY;
-int boardOffsetX, boardOffsetY;
+TextLabel fixedText[TEXT_COUNT] = {
+    {"<< REWIND", 40},
+    {"Get Ready!", 30},
+    {"YOU WIN!", 60},
+    {"GAME OVER", 60},
+    {"Press ESC for Menu", 20},
+    {"Press 'R' to RESTART", 25},
+    {"Hold BACKSPACE to rewind", 20}};
+
+TextLabel scoreLabel, modeLabel, autopilotLabel, levelLabel, levelNameLabel, countdownLabel;
+TextLabel highscoreLabel, themeMenuLabel, modeMenuLabel, autopilotMenuLabel;
+TextLabel leaderboardLabels[leaderboardShown];
 
 // definitions
 void InitGameGrid();
-void InitHurdles(GameState &game);
-void LoadHighscore(GameState &game);
+void OpenLeaderboard(GameState &game);
+void RankRun(GameState &game, const std::string &replay);
+void EndRun(GameState &game);
 void CheckSaveFile(GameState &game);
-bool IsTileBlocked(int x, int y, GameState &game, bool hurdlesActive);
-void ResetGame(GameState &game, bool fullReset);
+void LoadStoryLevels(GameState &game);
+void PreloadNextLevel(GameState &game);
+void CollectLevelBuild(GameState &game);
+void StartNewGame(GameState &game);
+bool IsValidTurn(char current, char key);
+void RecordInputLatency(double pressedAt);
 void LoadGame(GameState &game);
 void SaveGame(GameState &game);
 void UpdateMenu(GameState &game);
 void UpdateGameplay(GameState &game);
 void DrawMenu(GameState &game);
+void RedrawBoardLayer(GameState &game, Color cMenuBg, Color cBg, Color cGrid);
+void RedrawSpriteAtlas(GameState &game, Color cSnake, Color cFood);
+float MotionAlpha(const GameState &game);
+void DrawSpriteQuad(int slot, float cellX, float cellY);
+const ThemeColors &GetThemeColors(Theme theme);
+void LayoutFixedText();
+const TextLabel &UpdateLabel(TextLabel &label, long long key, int fontSize, const char *format, ...);
+void DrawCentered(const TextLabel &label, int y, Color color);
+void UpdateDrawLayers(GameState &game);
 void DrawGameplay(GameState &game);
-
-int main()
+void DrawStatsOverlay();
+bool IsIdleScreen(const GameState &game);
+uint64_t ScreenKey(const GameState &game);
+bool RunFrame(GameState &game);
+void RunRenderBenchmark(GameState &game);
+void RunIdleBenchmark(GameState &game);
+int RunOffscreenBenchmark(GameState &game, const char *pngDir);
+void RunReplayViewer(GameState &game, const char *path);
+void RunArenaView(GameState &game, int snakeCount);
+
+int main(int argc, char **argv)
 {
-    InitWindow(0, 0, "Snake Game - Ultimate Version");
-    SetTargetFPS(60);
+    // the offscreen benchmark draws into a texture behind a hidden window of
+    // a fixed size, so its frames come out the same on every machine
+    bool offscreen = argc > 1 && strcmp(argv[1], "--bench-offscreen") == 0;
+    if (offscreen)
+    {
+        SetConfigFlags(FLAG_WINDOW_HIDDEN);
+        InitWindow(offscreenWidth, offscreenHeight, "Snake Game - Ultimate Version");
+    }
+    else
+    {
+        // no frame cap, vsync paces us at whatever the display runs at
+        SetConfigFlags(FLAG_VSYNC_HINT);
+        InitWindow(0, 0, "Snake Game - Ultimate Version");
+    }
 
     InitGameGrid(); // setup the board dimensions
+    LayoutFixedText();
 
     // setup state
     GameState game;
+    game.gridCountX = gridCountX;
+    game.gridCountY = gridCountY;
+    SeedRandom(game, (uint64_t)time(nullptr));
     game.snakeX = gridCountX / 2;
     game.snakeY = gridCountY / 2;
 
     // load assets and data
-    InitHurdles(game);
-    LoadHighscore(game);
+    StartPersistence();
+    LoadStoryLevels(game);
+    OpenLeaderboard(game);
     CheckSaveFile(game);
     ResetGame(game, true);
 
-    // main loop
-    while (true)
+    // frame time vs snake length, prints csv and quits
+    if (argc > 1 && strcmp(argv[1], "--bench-render") == 0)
     {
-        // update loop
-        switch (game.stateofgame)
-        {
-        case 0:
-            UpdateMenu(game);
-            break;
-        case 2:
-            if (IsKeyPressed(KEY_ESCAPE))
-                game.stateofgame = 0;
-            UpdateGameplay(game);
-            break;
-        }
+        RunRenderBenchmark(game);
+        StopPersistence();
+        CloseWindow();
+        return 0;
+    }
 
-        // render loop
-        BeginDrawing();
-        switch (game.stateofgame)
-        {
-        case 0:
-            DrawMenu(game);
-            break;
-        case 2:
-            DrawGameplay(game);
-            break;
-        }
-        EndDrawing();
+    // scripted scenes drawn offscreen, prints csv and optionally pngs, then quits
+    if (offscreen)
+    {
+        int status = RunOffscreenBenchmark(game, argc > 2 ? argv[2] : nullptr);
+        StopPersistence();
+        CloseWindow();
+        return status;
     }
 
+    // cpu use of the idle screens with and without throttling, then quit
+    if (argc > 1 && strcmp(argv[1], "--bench-idle") == 0)
+    {
+        RunIdleBenchmark(game);
+        StopPersistence();
+        CloseWindow();
+        return 0;
+    }
+
+    // bot snakes only, then quit
+    if (argc > 1 && strcmp(argv[1], "--arena") == 0)
+    {
+        RunArenaView(game, argc > 2 ? atoi(argv[2]) : 500);
+        StopPersistence();
+        CloseWindow();
+        return 0;
+    }
+
+    // watch a recorded game, then quit
+    if (argc > 2 && strcmp(argv[1], "--replay") == 0)
+    {
+        RunReplayViewer(game, argv[2]);
+        StopPersistence();
+        CloseWindow();
+        return 0;
+    }
+
+    // every session overwrites the last one's events, snake_telemetry reads them
+    if (!StartTelemetry(telemetryPath))
+        printf("can't write %s, playing without telemetry\n", telemetryPath);
+
+    // main loop
+    lastFrameStart = GetTime();
+    while (true)
+        RunFrame(game);
+
+    StopTelemetry();
+    StopPersistence();
+    UnloadRenderTexture(boardLayer);
+    UnloadRenderTexture(spriteAtlas);
     CloseWindow();
     return 0;
 }
@@ -157,186 +357,315 @@ void InitGameGrid()
     boardOffsetY = (screenHeight - boardHeight) / 2;
 }
 
-// checks if a coordinate hits the snake or a wall
-bool IsTileBlocked(int x, int y, GameState &game, bool hurdlesActive)
+void OpenLeaderboard(GameState &game)
 {
-    for (int i = 0; i < game.snakeLength; i++)
-    {
-        if (game.snakePosition[i][0] == x && game.snakePosition[i][1] == y)
-            return true;
-    }
+    ProfileZone zone(ZONE_HIGHSCORE);
+    if (!LoadLeaderboard(leaderboard, leaderboardPath, leaderboardLockPath))
+        printf("%s is damaged, it gets rewritten with the next run\n", leaderboardPath);
+    leaderboardCheckedAt = GetTime();
+
+    // reads the whole log under the lock with its first run
+    diskLeaderboard.path = leaderboardPath;
+    diskLeaderboard.lockPath = leaderboardLockPath;
+    diskLeaderboard.keepsReplays = true;
+
+    // the single highscore of older versions becomes a run of the mode the
+    // game starts in, without a duration. the menu shows it after its next
+    // refresh
+    GameMode mode = game.currentMode;
+    QueueFileTask([mode]() { ImportLegacyHighscore(diskLeaderboard, legacyHighscorePath, mode); });
+    game.highscore = LeaderboardBest(leaderboard, game.currentMode);
+}
 
-    if (hurdlesActive)
-    {
-        for (int i = 0; i < game.hurdleCount; i++)
-        {
-            if (game.hurdles[i][0] == x && game.hurdles[i][1] == y)
-                return true;
-        }
-    }
-    return false;
+// puts a finished run on the board, with its replay kept next to it when it
+// made the cut and was recorded (replay is empty otherwise). it shows up here
+// right away, the append waits on the lock and the disk so the worker does it.
+// a run the log doesn't keep leaves the menu's board with its next refresh
+void RankRun(GameState &game, const std::string &replay)
+{
+    ProfileZone zone(ZONE_HIGHSCORE);
+    if (runAutopiloted)
+        return;
+
+    LeaderboardEntry entry;
+    entry.mode = game.currentMode;
+    entry.score = game.score;
+    entry.length = game.snake.Length();
+    entry.durationMs = (uint32_t)(runSeconds * 1000.0f);
+    entry.date = (int64_t)time(nullptr);
+    entry.replaySeed = replay.empty() ? 0 : recording.seed;
+    ExpectLeaderboardEntry(leaderboard, entry);
+    game.highscore = LeaderboardBest(leaderboard, game.currentMode);
+
+    QueueFileTask([entry, replay]() {
+        if (AddLeaderboardEntry(diskLeaderboard, entry, replay) > 0)
+            return;
+        std::lock_guard<std::mutex> lock(unrankedMutex);
+        unrankedRuns.push_back(entry);
+    });
 }
 
-// resets game state
-void ResetGame(GameState &game, bool fullReset)
+// writes the replay of a game that is over and ranks it, once
+void EndRun(GameState &game)
 {
-    if (fullReset)
+    if (!game.gameOver || runEnded)
+        return;
+    runEnded = true;
+    std::string replay;
+    if (recordingActive)
     {
-        game.gameOver = false;
-        game.score = 0;
-        game.storyLevel = 1;
-        game.snakeLength = 4;
-        game.key = 'R';
-        game.moveTimer = 0.0f;
-        game.moveInterval = 0.1f;
-        game.allowMove = true;
-        game.isLevelTransitioning = false;
-        game.transitionTimer = 0.0f;
+        FinishRecording(recording, game);
+        replay = EncodeReplay(recording);
+        QueueFileWrite(lastReplayPath, replay);
+        recordingActive = false;
     }
+    RankRun(game, replay);
+}
 
-    // reset snake to middle
-    int cx = gridCountX / 2;
-    int cy = gridCountY / 2;
-    for (int i = 0; i < game.snakeLength; i++)
+void CheckSaveFile(GameState &game)
+{
+    FILE *savecheck = fopen(saveFilePath, "rb");
+    if (savecheck)
     {
-        game.snakePosition[i][0] = cx;
-        game.snakePosition[i][1] = cy;
+        game.hasSaveFile = true;
+        fclose(savecheck);
     }
-
-    // spawn food somewhere safe
-    bool hurdlesActive = (game.currentMode == HARD || (game.currentMode == STORY && game.storyLevel >= 3));
-    do
-    {
-        game.foodX = GetRandomValue(0, gridCountX - 1);
-        game.foodY = GetRandomValue(0, gridCountY - 1);
-    } while (IsTileBlocked(game.foodX, game.foodY, game, hurdlesActive));
 }
 
-void InitHurdles(GameState &game)
+// the cache is rewritten whenever the text changed, a broken file only
+// costs the custom levels
+void LoadStoryLevels(GameState &game)
 {
-    int lastX = gridCountX - 1;
-    int lastY = gridCountY - 1;
-    int idx = 0;
-
-    // set up corner walls
-    game.hurdles[idx][0] = 0;
-    game.hurdles[idx++][1] = 0;
-    game.hurdles[idx][0] = 1;
-    game.hurdles[idx++][1] = 0;
-    game.hurdles[idx][0] = 2;
-    game.hurdles[idx++][1] = 0;
-    game.hurdles[idx][0] = 0;
-    game.hurdles[idx++][1] = 1;
-    game.hurdles[idx][0] = 0;
-    game.hurdles[idx++][1] = 2;
-
-    game.hurdles[idx][0] = lastX;
-    game.hurdles[idx++][1] = lastY;
-    game.hurdles[idx][0] = lastX - 1;
-    game.hurdles[idx++][1] = lastY;
-    game.hurdles[idx][0] = lastX - 2;
-    game.hurdles[idx++][1] = lastY;
-    game.hurdles[idx][0] = lastX;
-    game.hurdles[idx++][1] = lastY - 1;
-    game.hurdles[idx][0] = lastX;
-    game.hurdles[idx++][1] = lastY - 2;
-
-    game.hurdles[idx][0] = lastX;
-    game.hurdles[idx++][1] = 0;
-    game.hurdles[idx][0] = lastX - 1;
-    game.hurdles[idx++][1] = 0;
-    game.hurdles[idx][0] = lastX - 2;
-    game.hurdles[idx++][1] = 0;
-    game.hurdles[idx][0] = lastX;
-    game.hurdles[idx++][1] = 1;
-    game.hurdles[idx][0] = lastX;
-    game.hurdles[idx++][1] = 2;
-
-    game.hurdles[idx][0] = 0;
-    game.hurdles[idx++][1] = lastY;
-    game.hurdles[idx][0] = 1;
-    game.hurdles[idx++][1] = lastY;
-    game.hurdles[idx][0] = 2;
-    game.hurdles[idx++][1] = lastY;
-    game.hurdles[idx][0] = 0;
-    game.hurdles[idx++][1] = lastY - 1;
-    game.hurdles[idx][0] = 0;
-    game.hurdles[idx++][1] = lastY - 2;
-
-    // barrier in the middle
-    int gap = 4;
-    int startY = (gridCountY - gap) / 2 - 1;
-    for (int i = 0; i < 7; i++)
+    std::string cache, error;
+    if (!LoadLevels(levelFilePath, levelCachePath, storyLevels, cache, error))
     {
-        game.hurdles[idx][0] = i + (gridCountX - 7) / 2;
-        game.hurdles[idx++][1] = startY;
-        game.hurdles[idx][0] = i + (gridCountX - 7) / 2;
-        game.hurdles[idx++][1] = startY + gap + 1;
+        printf("%s, playing the built in levels\n", error.c_str());
+        return;
     }
-    game.hurdleCount = idx;
+    game.levels = &storyLevels;
+    if (!cache.empty())
+        QueueFileWrite(levelCachePath, cache);
 }
 
-void LoadHighscore(GameState &game)
+// starts building the story level after the current one in the background.
+// a build still running is left to finish, replacing its future would wait
+// for it, and the level it delivers gets checked again once it's collected
+void PreloadNextLevel(GameState &game)
 {
-    std::ifstream hsFileIn("highscore.txt");
-    if (hsFileIn.is_open())
-    {
-        hsFileIn >> game.highscore;
-        hsFileIn.close();
-    }
+    if (levelBuild.valid() && levelBuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+    const LevelSet &levels = StoryLevels(game);
+    if (game.currentMode != STORY || game.storyLevel >= (int)levels.levels.size())
+        return;
+    const LevelDef *def = &levels.levels[game.storyLevel];
+    int w = game.gridCountX;
+    int h = game.gridCountY;
+    if (game.nextLevel.def == def && game.nextLevel.width == w && game.nextLevel.height == h)
+        return;
+    levelBuild = std::async(std::launch::async, [def, w, h]() {
+        LevelLayout layout;
+        BuildLevel(*def, w, h, layout);
+        return layout;
+    });
 }
 
-void CheckSaveFile(GameState &game)
+// hands a finished build to the game, never waits for one
+void CollectLevelBuild(GameState &game)
 {
-    std::ifstream savecheck("savefile.txt");
-    if (savecheck.is_open())
+    if (levelBuild.valid() && levelBuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
     {
-        game.hasSaveFile = true;
-        savecheck.close();
+        game.nextLevel = levelBuild.get();
+        PreloadNextLevel(game); // a rewind may have moved on to another level meanwhile
     }
 }
 
+// fresh game with a new seed, recorded from the first tick
+void StartNewGame(GameState &game)
+{
+    EndRun(game);
+    uint64_t seed = ((uint64_t)RandomValue(game, 0, INT_MAX) << 32) ^ (uint64_t)RandomValue(game, 0, INT_MAX);
+    StartRecording(recording, game, seed);
+    recordingActive = true;
+    runSeconds = 0.0f;
+    runTicks = 0;
+    runAutopiloted = false;
+    runEnded = false;
+    PushTelemetry(TELEMETRY_GAME, (uint8_t)game.currentMode, 0, 0);
+    inputQueue.Clear();
+    ResetAutopilot(autopilot);
+    ResetRewind(rewindHistory, game);
+    rewinding = false;
+    smoothMotion = false;
+    PreloadNextLevel(game);
+}
+
+// a continued game has no seed to start from, so it isn't recorded
 void LoadGame(GameState &game)
 {
+    ProfileZone zone(ZONE_LOAD);
     if (game.hasSaveFile)
     {
-        std::ifstream load("savefile.txt");
-        if (load.is_open())
+        // a save may still be queued, make sure we read the latest one
+        FlushPersistence();
+        std::string error;
+        if (ReadSaveFile(saveFilePath, game, error))
         {
-            int modeInt;
-            load >> game.snakeLength >> game.score >> game.key >> game.foodX >> game.foodY >> modeInt;
-            game.currentMode = (GameMode)modeInt;
-            for (int i = 0; i < game.snakeLength; i++)
-            {
-                load >> game.snakePosition[i][0] >> game.snakePosition[i][1];
-            }
-            load.close();
-            game.allowMove = true;
+            recordingActive = false;
+            runSeconds = 0.0f;
+            runTicks = 0;
+            runAutopiloted = false;
+            runEnded = false;
+            PushTelemetry(TELEMETRY_GAME, (uint8_t)game.currentMode, 0, 1);
+            inputQueue.Clear();
+            ResetAutopilot(autopilot);
+            ResetRewind(rewindHistory, game);
+            rewinding = false;
+            smoothMotion = false;
             game.stateofgame = 2;
             game.isLevelTransitioning = false;
+            PreloadNextLevel(game);
+        }
+        else
+        {
+            printf("%s %s\n", saveFilePath, error.c_str());
+            game.hasSaveFile = false;
         }
     }
 }
 
+// a turn that changes where the snake goes, not straight on or back into itself
+bool IsValidTurn(char current, char key)
+{
+    switch (key)
+    {
+    case 'R':
+        return current != 'R' && current != 'L';
+    case 'L':
+        return current != 'L' && current != 'R';
+    case 'U':
+        return current != 'U' && current != 'D';
+    case 'D':
+        return current != 'D' && current != 'U';
+    default:
+        return false;
+    }
+}
+
+void RecordInputLatency(double pressedAt)
+{
+    lastInputLatency = (float)((GetTime() - pressedAt) * 1000.0);
+    if (avgInputLatency == 0.0f)
+        avgInputLatency = lastInputLatency;
+    else
+        avgInputLatency += (lastInputLatency - avgInputLatency) * 0.1f;
+    if (lastInputLatency > maxInputLatency)
+        maxInputLatency = lastInputLatency;
+}
+
+// hands the save to the persistence thread, the file shows up a moment later
 void SaveGame(GameState &game)
 {
-    std::ofstream save("savefile.txt");
-    if (save.is_open())
+    ProfileZone zone(ZONE_SAVE);
+    std::string save = EncodeSave(game);
+    if (save.empty())
+        return;
+    QueueFileWrite(saveFilePath, save);
+    game.hasSaveFile = true;
+    PushTelemetry(TELEMETRY_SAVE, 0, runTicks, (int32_t)save.size());
+}
+
+// FRAME
+
+// screens where nothing moves unless a key is pressed or a second passes
+bool IsIdleScreen(const GameState &game)
+{
+    if (!idleThrottle || showStats || rewinding)
+        return false;
+    return game.stateofgame == 0 || game.gameOver || game.isLevelTransitioning;
+}
+
+// everything the idle screens show, a different key means a new frame
+uint64_t ScreenKey(const GameState &game)
+{
+    const long long parts[] = {game.stateofgame, game.menuOption, game.currentMode, game.theme, autopilot.mode,
+                               game.highscore, game.hasSaveFile, game.score, game.gameOver, game.gameWon,
+                               game.isLevelTransitioning, (long long)ceil(game.transitionTimer), game.storyLevel,
+                               (long long)leaderboard.records, (long long)leaderboard.generation, screenWidth,
+                               screenHeight};
+    uint64_t key = 0xCBF29CE484222325ull;
+    for (long long part : parts)
+        key = (key ^ (uint64_t)part) * 0x100000001B3ull;
+    return key;
+}
+
+// one pass of the main loop, false when the frame was skipped. skipped
+// frames never reach EndDrawing, so raylib's frame time would go stale and
+// the loop keeps its own
+bool RunFrame(GameState &game)
+{
+    double now = GetTime();
+    frameTime = (float)(now - lastFrameStart);
+    lastFrameStart = now;
+
+    ProfilerBeginFrame();
+
+    if (IsKeyPressed(KEY_F3))
     {
-        save << game.snakeLength << "\n"
-             << game.score << "\n"
-             << game.key << "\n"
-             << game.foodX << "\n"
-             << game.foodY << "\n"
-             << (int)game.currentMode;
-        for (int i = 0; i < game.snakeLength; i++)
+        showStats = !showStats;
+        SetProfilerEnabled(showStats);
+    }
+    if (IsKeyPressed(KEY_F4) && showStats)
+        QueueFileWrite(traceFilePath, ProfileTraceJson());
+
+    // update loop
+    {
+        ProfileZone zone(ZONE_UPDATE);
+        switch (game.stateofgame)
         {
-            save << "\n"
-                 << game.snakePosition[i][0] << " " << game.snakePosition[i][1];
+        case 0:
+            UpdateMenu(game);
+            break;
+        case 2:
+            if (IsKeyPressed(KEY_ESCAPE))
+            {
+                EndRun(game);
+                game.stateofgame = 0;
+            }
+            UpdateGameplay(game);
+            break;
         }
-        save.close();
-        game.hasSaveFile = true;
     }
+
+    // the last frame is still on screen, sleep instead of drawing it again
+    uint64_t screenKey = ScreenKey(game);
+    if (IsIdleScreen(game) && screenKey == lastScreenKey && !IsWindowResized())
+    {
+        WaitTime(idleFrameTime);
+        PollInputEvents();
+        return false;
+    }
+    lastScreenKey = screenKey;
+
+    // render loop
+    BeginDrawing();
+    switch (game.stateofgame)
+    {
+    case 0:
+        DrawMenu(game);
+        break;
+    case 2:
+        DrawGameplay(game);
+        break;
+    }
+    if (showStats)
+        DrawStatsOverlay();
+    {
+        ProfileZone zone(ZONE_PRESENT);
+        EndDrawing();
+    }
+
+    ProfilerEndFrame();
+    return true;
 }
 
 //
@@ -349,10 +678,10 @@ void UpdateMenu(GameState &game)
         game.menuOption++;
     if (IsKeyPressed(KEY_UP))
         game.menuOption--;
-    if (game.menuOption > 5)
+    if (game.menuOption > 6)
         game.menuOption = 1;
     if (game.menuOption < 1)
-        game.menuOption = 5;
+        game.menuOption = 6;
 
     // handle mode switching
     if (game.menuOption == 4)
@@ -360,7 +689,7 @@ void UpdateMenu(GameState &game)
         if (IsKeyPressed(KEY_RIGHT))
         {
             int next = (int)game.currentMode + 1;
-            if (next > 3)
+            if (next > 4)
                 next = 0;
             game.currentMode = (GameMode)next;
         }
@@ -368,11 +697,35 @@ void UpdateMenu(GameState &game)
         {
             int prev = (int)game.currentMode - 1;
             if (prev < 0)
-                prev = 3;
+                prev = 4;
             game.currentMode = (GameMode)prev;
         }
     }
 
+    // skipped until the next turn while another instance holds the lock
+    if (GetTime() - leaderboardCheckedAt >= leaderboardRefresh)
+    {
+        ProfileZone zone(ZONE_HIGHSCORE);
+        {
+            std::lock_guard<std::mutex> lock(unrankedMutex);
+            for (const LeaderboardEntry &entry : unrankedRuns)
+                ForgetLeaderboardEntry(leaderboard, entry);
+            unrankedRuns.clear();
+        }
+        RefreshLeaderboard(leaderboard);
+        leaderboardCheckedAt = GetTime();
+    }
+    game.highscore = LeaderboardBest(leaderboard, game.currentMode);
+
+    // handle autopilot switching
+    if (game.menuOption == 5)
+    {
+        if (IsKeyPressed(KEY_RIGHT))
+            autopilot.mode = (AutopilotMode)(((int)autopilot.mode + 1) % 3);
+        if (IsKeyPressed(KEY_LEFT))
+            autopilot.mode = (AutopilotMode)(((int)autopilot.mode + 2) % 3);
+    }
+
     if (IsKeyPressed(KEY_ENTER))
     {
         switch (game.menuOption)
@@ -382,15 +735,14 @@ void UpdateMenu(GameState &game)
             break;
         case 2: // new game
             game.stateofgame = 2;
-            ResetGame(game, true);
+            StartNewGame(game);
             break;
         case 3: // toggle theme
-            if (game.theme == "Classic")
-                game.theme = "Desert";
-            else
-                game.theme = "Classic";
+            game.theme = (Theme)((game.theme + 1) % THEME_COUNT);
             break;
-        case 5: // exit
+        case 6: // exit
+            StopTelemetry();
+            StopPersistence(); // don't lose a queued save
             exit(0);
             break;
         default:
@@ -401,204 +753,158 @@ void UpdateMenu(GameState &game)
 
 void UpdateGameplay(GameState &game)
 {
-    if (game.gameOver)
+    CollectLevelBuild(game);
+
+    // nothing else runs while scrubbing back
+    if (IsKeyDown(KEY_BACKSPACE))
     {
-        if (game.hasSaveFile)
+        if (!rewinding)
         {
-            remove("savefile.txt");
-            game.hasSaveFile = false;
+            rewinding = true;
+            rewindCursor = (float)RewindNewest(rewindHistory);
         }
-        if (IsKeyPressed(KEY_R))
-            ResetGame(game, true);
+        rewindCursor -= frameTime / game.moveInterval * rewindSpeed;
+        if (rewindCursor < (float)RewindOldest(rewindHistory))
+            rewindCursor = (float)RewindOldest(rewindHistory);
+        RestoreRewind(rewindHistory, game, (uint32_t)rewindCursor);
+        game.isLevelTransitioning = false;
+        smoothMotion = false;
         return;
     }
-
-    bool wallsActive = (game.currentMode == NORMAL || game.currentMode == HARD || (game.currentMode == STORY && game.storyLevel >= 2));
-    bool hurdlesActive = (game.currentMode == HARD || (game.currentMode == STORY && game.storyLevel >= 3));
-
-    // handle story progression
-    if (game.currentMode == STORY)
+    if (rewinding)
     {
-        int nextLevel = 1;
-        if (game.score >= 50 && game.score < 100)
-            nextLevel = 2;
-        else if (game.score >= 100)
-            nextLevel = 3;
-
-        if (nextLevel > game.storyLevel)
-        {
-            game.storyLevel = nextLevel;
-            game.isLevelTransitioning = true;
-            game.transitionTimer = game.transitionDuration;
-            SaveGame(game);
-
-            // respawn logic to prevent glitches on level change
-            game.key = 'R';
-            int cx = gridCountX / 2;
-            int cy = gridCountY / 2;
-            for (int i = 0; i < game.snakeLength; i++)
-            {
-                game.snakePosition[i][0] = cx - i;
-                game.snakePosition[i][1] = cy;
-            }
-
-            // check hurdles before spawning food
-            bool nextHurdles = (game.storyLevel >= 3);
-            do
-            {
-                game.foodX = GetRandomValue(0, gridCountX - 1);
-                game.foodY = GetRandomValue(0, gridCountY - 1);
-            } while (IsTileBlocked(game.foodX, game.foodY, game, nextHurdles));
-        }
+        // the ticks scrubbed over never happened
+        rewinding = false;
+        uint32_t tick = (uint32_t)rewindCursor;
+        TruncateRewind(rewindHistory, tick);
+        runTicks = tick;
+        if (recordingActive)
+            TruncateRecording(recording, tick);
+        inputQueue.Clear();
+        ResetAutopilot(autopilot);
+        PreloadNextLevel(game);
     }
 
-    // save highscore if beat
-    if (game.score > game.highscore)
+    if (game.gameOver)
     {
-        game.highscore = game.score;
-        std::ofstream hsOut("highscore.txt");
-        if (hsOut.is_open())
+        if (game.hasSaveFile)
         {
-            hsOut << game.highscore;
-            hsOut.close();
+            QueueFileRemove(saveFilePath);
+            game.hasSaveFile = false;
         }
+        if (IsKeyPressed(KEY_R))
+            StartNewGame(game);
+        return;
     }
 
+    // the hud shows a highscore being beaten right away, the board only
+    // hears about it once the run is over
+    if (game.score > game.highscore && !runAutopiloted)
+        game.highscore = game.score;
+
     // handle transition timer
     if (game.isLevelTransitioning)
     {
-        game.transitionTimer -= GetFrameTime();
+        game.transitionTimer -= frameTime;
         if (game.transitionTimer <= 0)
         {
             game.isLevelTransitioning = false;
             game.transitionTimer = 0;
-            game.allowMove = true;
         }
         return;
     }
 
-    // input check
-    if (game.allowMove)
+    // queue every arrow press, repeats of the last queued direction add nothing
+    int arrowKeys[] = {KEY_RIGHT, KEY_LEFT, KEY_UP, KEY_DOWN};
+    const char arrowDirs[] = {'R', 'L', 'U', 'D'};
+    for (int i = 0; i < 4; i++)
     {
-        // prevent 180 degree turns
-        if (IsKeyPressed(KEY_RIGHT) && game.key != 'L')
-        {
-            game.key = 'R';
-            game.allowMove = false;
-        }
-        else if (IsKeyPressed(KEY_LEFT) && game.key != 'R')
-        {
-            game.key = 'L';
-            game.allowMove = false;
-        }
-        else if (IsKeyPressed(KEY_UP) && game.key != 'D')
-        {
-            game.key = 'U';
-            game.allowMove = false;
-        }
-        else if (IsKeyPressed(KEY_DOWN) && game.key != 'U')
-        {
-            game.key = 'D';
-            game.allowMove = false;
-        }
+        if (!IsKeyPressed(arrowKeys[i]))
+            continue;
+        char last = inputQueue.count > 0 ? inputQueue.Last() : game.key;
+        if (arrowDirs[i] != last)
+            inputQueue.Push(arrowDirs[i], GetTime());
     }
 
-    // move timer loop
-    game.moveTimer += GetFrameTime();
-    if (game.moveTimer >= game.moveInterval)
+    // fixed timestep, leftover time carries into the next tick so the speed
+    // doesn't depend on the frame rate. a slow frame runs several ticks
+    game.moveTimer += frameTime;
+    int ticks = 0;
+    while (game.moveTimer >= game.moveInterval && !game.gameOver && !game.isLevelTransitioning)
     {
-        game.moveTimer = 0.0f;
-        game.allowMove = true;
-
-        int nextX = game.snakePosition[0][0];
-        int nextY = game.snakePosition[0][1];
-
-        switch (game.key)
+        // after a long stall (window dragged, debugger) drop the backlog
+        // instead of fast forwarding through it
+        if (ticks == maxTicksPerFrame)
         {
-        case 'R':
-            nextX++;
-            break;
-        case 'L':
-            nextX--;
-            break;
-        case 'U':
-            nextY--;
-            break;
-        case 'D':
-            nextY++;
+            game.moveTimer = fmodf(game.moveTimer, game.moveInterval);
             break;
         }
-
-        // wall collision
-        if (nextX < 0 || nextX >= gridCountX || nextY < 0 || nextY >= gridCountY)
+        ticks++;
+        game.moveTimer -= game.moveInterval;
+
+        // one turn per tick. the 180 degree rule is checked against the
+        // direction at this tick, so U then L while going right is fine
+        // while a lone L is dropped. only real turns reach Step, so the
+        // recording holds one entry per turn
+        int64_t tickStart = ProfilerNow();
+        Input input;
+        char key;
+        double pressedAt;
+        if (autopilot.mode != AUTOPILOT_OFF)
         {
-            if (wallsActive)
-            {
-                game.gameOver = true;
-                return;
-            }
-            else
-            {
-                // wrap around logic
-                if (nextX < 0)
-                    nextX = gridCountX - 1;
-                if (nextX >= gridCountX)
-                    nextX = 0;
-                if (nextY < 0)
-                    nextY = gridCountY - 1;
-                if (nextY >= gridCountY)
-                    nextY = 0;
-            }
+            // the bot drives, arrow presses are ignored
+            inputQueue.Clear();
+            input = AutopilotDecide(autopilot, game);
+            if (input.key == game.key)
+                input.key = 0;
+            runAutopiloted = true;
         }
-
-        // hurdle collision
-        if (hurdlesActive)
+        else
         {
-            for (int i = 0; i < game.hurdleCount; i++)
+            while (inputQueue.Pop(key, pressedAt))
             {
-                if (nextX == game.hurdles[i][0] && nextY == game.hurdles[i][1])
+                if (IsValidTurn(game.key, key))
                 {
-                    game.gameOver = true;
-                    return;
+                    input.key = key;
+                    RecordInputLatency(pressedAt);
+                    break;
                 }
             }
         }
 
-        // move body segments
-        for (int i = game.snakeLength; i > 0; i--)
+        Cell oldTail = game.snake.Tail();
+        int oldLength = game.snake.Length();
+        runSeconds += game.moveInterval;
+        runTicks++;
+        int events = Step(game, input);
+        if (events & EVENT_ATE_FOOD)
+            PushTelemetry(TELEMETRY_FOOD, 0, runTicks, game.score);
+        if (events & EVENT_DIED)
+            PushTelemetry(TELEMETRY_DEATH, (uint8_t)game.deathCause, runTicks, game.score);
+        if (events & EVENT_WON)
+            PushTelemetry(TELEMETRY_WON, 0, runTicks, game.score);
+        if (events & EVENT_LEVEL_UP)
+            PushTelemetry(TELEMETRY_LEVEL, 0, runTicks, game.storyLevel);
+
+        // a snake that grew kept its tail where it was
+        tailFrom = game.snake.Length() == oldLength ? oldTail : game.snake.Tail();
+        smoothMotion = !(events & EVENT_LEVEL_UP);
+        RecordRewind(rewindHistory, game, events);
+
+        if (recordingActive)
+            RecordTick(recording, input);
+
+        if (events & EVENT_LEVEL_UP)
         {
-            game.snakePosition[i][0] = game.snakePosition[i - 1][0];
-            game.snakePosition[i][1] = game.snakePosition[i - 1][1];
+            game.isLevelTransitioning = true;
+            game.transitionTimer = game.transitionDuration;
+            game.moveTimer = 0.0f;
+            inputQueue.Clear();
+            PreloadNextLevel(game);
         }
-        game.snakePosition[0][0] = nextX;
-        game.snakePosition[0][1] = nextY;
-
-        // food collision
-        if (nextX == game.foodX && nextY == game.foodY)
-        {
-            game.snakeLength++;
-            game.score += 10;
-            if (game.moveInterval > 0.05f)
-                game.moveInterval -= 0.001f; // slight speed up
-            do
-            {
-                game.foodX = GetRandomValue(0, gridCountX - 1);
-                game.foodY = GetRandomValue(0, gridCountY - 1);
-            } while (IsTileBlocked(game.foodX, game.foodY, game, hurdlesActive));
+        if (events & (EVENT_ATE_FOOD | EVENT_LEVEL_UP))
             SaveGame(game);
-        }
-
-        // self collision
-        if (!game.gameOver)
-        {
-            for (int i = 1; i < game.snakeLength; i++)
-            {
-                if (game.snakePosition[0][0] == game.snakePosition[i][0] && game.snakePosition[0][1] == game.snakePosition[i][1])
-                {
-                    game.gameOver = true;
-                }
-            }
-        }
+        PushTelemetry(TELEMETRY_TICK, 0, runTicks, (int32_t)(ProfilerNow() - tickStart));
     }
 }
 
@@ -606,249 +912,863 @@ void UpdateGameplay(GameState &game)
 
 void DrawMenu(GameState &game)
 {
+    ProfileZone zone(ZONE_MENU);
+
     // colors based on theme
-    Color bg, box, sel, text, textSel;
-    if (game.theme == "Classic")
-    {
-        bg = {185, 205, 160, 255};
-        box = {160, 190, 140, 255};
-        sel = {120, 150, 110, 255};
-        text = {60, 80, 50, 255};
-        textSel = WHITE;
-    }
-    else
-    {
-        bg = {240, 225, 185, 255};
-        box = {225, 210, 178, 255};
-        sel = {25, 40, 75, 255};
-        text = {60, 45, 25, 255};
-        textSel = WHITE;
-    }
+    const ThemeColors &colors = GetThemeColors(game.theme);
+    Color box = colors.menuBox;
+    Color sel = colors.menuSel;
+    Color text = colors.menuText;
+    Color textSel = WHITE;
 
-    ClearBackground(bg);
+    ClearBackground(colors.menuBg);
     DrawText("SNAKE ULTIMATE", screenWidth / 2 - 200, 200, 50, text);
-    std::string hsText = "High Score: " + std::to_string(game.highscore);
-    DrawText(hsText.c_str(), screenWidth / 2 - 100, 260, 30, text);
+    const TextLabel &hsText = UpdateLabel(highscoreLabel, game.highscore, 30, "High Score: %i", game.highscore);
+    DrawText(hsText.text, screenWidth / 2 - 100, 260, 30, text);
 
     int startY = 250, gap = 70, boxW = 300, boxH = 50;
 
-    const char *titles[] = {"Continue", "New Game", "Theme", "Mode", "Exit"};
-    for (int i = 1; i <= 5; i++)
+    const char *titles[] = {"Continue", "New Game", "Theme", "Mode", "Autopilot", "Exit"};
+    for (int i = 1; i <= 6; i++)
     {
         int yPos = startY + (gap * (i - 1)) + 100;
-        std::string display = titles[i - 1];
+        const char *display = titles[i - 1];
 
         // custom labels
         if (i == 3)
-            display = "Theme: " + game.theme;
+            display = UpdateLabel(themeMenuLabel, game.theme, 20, "Theme: %s", colors.name).text;
         if (i == 4)
-        {
-            display = "Mode: ";
-            switch (game.currentMode)
-            {
-            case EASY:
-                display += "< Easy >";
-                break;
-            case NORMAL:
-                display += "< Normal >";
-                break;
-            case HARD:
-                display += "< Hard >";
-                break;
-            case STORY:
-                display += "< Story >";
-                break;
-            }
-        }
+            display = UpdateLabel(modeMenuLabel, game.currentMode, 20, "Mode: < %s >", modeMenuNames[game.currentMode]).text;
+        if (i == 5)
+            display = UpdateLabel(autopilotMenuLabel, autopilot.mode, 20, "Autopilot: < %s >", AutopilotModeName(autopilot.mode)).text;
 
         if (game.menuOption == i)
         {
             if (i == 1 && !game.hasSaveFile)
             {
                 DrawRectangle(screenWidth / 2 - 150, yPos, boxW, boxH, RED);
-                DrawText(display.c_str(), screenWidth / 2 - 40, yPos + 15, 20, WHITE);
+                DrawText(display, screenWidth / 2 - 40, yPos + 15, 20, WHITE);
             }
             else
             {
                 DrawRectangle(screenWidth / 2 - 150, yPos, boxW, boxH, sel);
                 // aligning text
-                int offset = (i == 3) ? 60 : (i == 4 ? 70 : 40);
+                int offset = (i == 3) ? 60 : (i == 4 || i == 5 ? 70 : 40);
                 if (i == 2)
                     offset = 45;
-                if (i == 5)
+                if (i == 6)
                     offset = 20;
-                DrawText(display.c_str(), screenWidth / 2 - offset, yPos + 15, 20, textSel);
+                DrawText(display, screenWidth / 2 - offset, yPos + 15, 20, textSel);
             }
         }
         else
         {
             DrawRectangleLines(screenWidth / 2 - 150, yPos, boxW, boxH, box);
-            int offset = (i == 3) ? 60 : (i == 4 ? 70 : 40);
+            int offset = (i == 3) ? 60 : (i == 4 || i == 5 ? 70 : 40);
             if (i == 2)
                 offset = 45;
-            if (i == 5)
+            if (i == 6)
                 offset = 20;
-            DrawText(display.c_str(), screenWidth / 2 - offset, yPos + 15, 20, text);
+            DrawText(display, screenWidth / 2 - offset, yPos + 15, 20, text);
         }
     }
-}
 
-void DrawGameplay(GameState &game)
-{
-    // local colors
-    Color cBg, cGrid, cSnake, cFood, cMenuBg;
-    if (game.theme == "Classic")
+    // best runs of the mode picked, next to the buttons
+    int listX = screenWidth / 2 + 200;
+    DrawText("Best Runs", listX, startY + 100, 20, text);
+    const auto &best = leaderboard.modes[game.currentMode];
+    if (best.empty())
+        DrawText("none yet", listX, startY + 135, 20, text);
+    int rank = 0;
+    for (const LeaderboardEntry &entry : best)
     {
-        cBg = {150, 180, 110, 255};
-        cGrid = {100, 130, 90, 255};
-        cSnake = {50, 70, 40, 255};
-        cFood = {200, 0, 0, 255};
-        cMenuBg = {185, 205, 160, 255};
+        if (rank == leaderboardShown)
+            break;
+        int seconds = (int)(entry.durationMs / 1000);
+        long long key = (long long)entry.durationMs << 32 | (uint32_t)entry.score;
+        // a highscore carried over from highscore.txt has no duration
+        const TextLabel &line =
+            entry.durationMs == 0
+                ? UpdateLabel(leaderboardLabels[rank], key, 20, "%d. %i", rank + 1, entry.score)
+                : UpdateLabel(leaderboardLabels[rank], key, 20, "%d. %i  %d:%02d", rank + 1, entry.score, seconds / 60,
+                              seconds % 60);
+        DrawText(line.text, listX, startY + 135 + rank * 30, 20, text);
+        rank++;
     }
-    else
+}
+
+// renders everything that stays put during play into boardLayer
+void RedrawBoardLayer(GameState &game, Color cMenuBg, Color cBg, Color cGrid)
+{
+    if (boardLayer.id == 0 || boardLayerWidth != screenWidth || boardLayerHeight != screenHeight)
     {
-        cBg = {255, 246, 199, 255};
-        cGrid = {232, 223, 194, 255};
-        cSnake = {15, 26, 51, 255};
-        cFood = {255, 79, 163, 255};
-        cMenuBg = {240, 225, 185, 255};
+        if (boardLayer.id != 0)
+            UnloadRenderTexture(boardLayer);
+        boardLayer = LoadRenderTexture(screenWidth, screenHeight);
     }
 
+    BeginTextureMode(boardLayer);
     ClearBackground(cMenuBg);
     DrawRectangle(boardOffsetX, boardOffsetY, boardWidth, boardHeight, cBg);
 
     // grid
-    for (int i = 0; i <= gridCountX; i++)
-        DrawLine(boardOffsetX + i * cellSize, boardOffsetY, boardOffsetX + i * cellSize, boardOffsetY + boardHeight, cGrid);
-    for (int i = 0; i <= gridCountY; i++)
-        DrawLine(boardOffsetX, boardOffsetY + i * cellSize, boardOffsetX + boardWidth, boardOffsetY + i * cellSize, cGrid);
-
-    bool wallsActive = (game.currentMode == NORMAL || game.currentMode == HARD || (game.currentMode == STORY && game.storyLevel >= 2));
-    bool hurdlesActive = (game.currentMode == HARD || (game.currentMode == STORY && game.storyLevel >= 3));
+    {
+        ProfileZone zone(ZONE_GRID);
+        for (int i = 0; i <= gridCountX; i++)
+            DrawLine(boardOffsetX + i * cellSize, boardOffsetY, boardOffsetX + i * cellSize, boardOffsetY + boardHeight, cGrid);
+        for (int i = 0; i <= gridCountY; i++)
+            DrawLine(boardOffsetX, boardOffsetY + i * cellSize, boardOffsetX + boardWidth, boardOffsetY + i * cellSize, cGrid);
+    }
 
     // draw hurdles
-    if (hurdlesActive)
+    if (HurdlesActive(game))
     {
-        for (int i = 0; i < game.hurdleCount; i++)
-            DrawRectangle(boardOffsetX + game.hurdles[i][0] * cellSize, boardOffsetY + game.hurdles[i][1] * cellSize, cellSize, cellSize, DARKGRAY);
+        ProfileZone zone(ZONE_HURDLES);
+        for (const Cell &h : game.hurdles)
+            DrawRectangle(boardOffsetX + h.x * cellSize, boardOffsetY + h.y * cellSize, cellSize, cellSize, DARKGRAY);
     }
 
-    // draw food
-    float fruitPixelX = boardOffsetX + game.foodX * cellSize + cellSize / 2.0f;
-    float fruitPixelY = boardOffsetY + game.foodY * cellSize + cellSize / 2.0f;
-    float fruitRadius = cellSize / 2.0f - 4;
+    // walls
+    if (WallsActive(game))
+    {
+        DrawRectangleLinesEx((Rectangle){(float)boardOffsetX, (float)boardOffsetY, (float)boardWidth, (float)boardHeight}, 4, RED);
+    }
+    EndTextureMode();
+
+    boardLayerTheme = (int)game.theme;
+    boardLayerMode = (int)game.currentMode;
+    boardLayerLevel = game.storyLevel;
+    boardLayerSeed = game.levelSeed;
+    boardLayerDensity = game.levelDensity;
+    boardLayerWidth = screenWidth;
+    boardLayerHeight = screenHeight;
+}
+
+// draws the snake head facing dir, centered on (x, y)
+void DrawHeadSprite(float x, float y, char dir, Color cSnake)
+{
+    DrawCircleV((Vector2){x, y}, cellSize / 2.0f, cSnake);
+
+    // eye calc
+    float eyeOffsetX = 0;
+    float eyeOffsetY = 0;
+    float eyeSep = 8;
+
+    switch (dir)
+    {
+    case 'R':
+        eyeOffsetX = eyeSep;
+        break;
+    case 'L':
+        eyeOffsetX = -eyeSep;
+        break;
+    case 'U':
+        eyeOffsetY = -eyeSep;
+        break;
+    case 'D':
+        eyeOffsetY = eyeSep;
+        break;
+    }
+
+    Vector2 leftEye, rightEye;
+    if (dir == 'U' || dir == 'D')
+    {
+        leftEye = {x - 6, y + eyeOffsetY};
+        rightEye = {x + 6, y + eyeOffsetY};
+    }
+    else
+    {
+        leftEye = {x + eyeOffsetX, y - 6};
+        rightEye = {x + eyeOffsetX, y + 6};
+    }
+
+    // draw eyes
+    DrawCircleV(leftEye, 5, WHITE);
+    DrawCircleV(rightEye, 5, WHITE);
+    DrawCircleV(leftEye, 2, BLACK);
+    DrawCircleV(rightEye, 2, BLACK);
+}
+
+// rasterizes every sprite for the current theme into spriteAtlas
+void RedrawSpriteAtlas(GameState &game, Color cSnake, Color cFood)
+{
+    if (spriteAtlas.id == 0)
+    {
+        spriteAtlas = LoadRenderTexture(spriteSize * SPRITE_COUNT, spriteSize);
+        SetTextureFilter(spriteAtlas.texture, TEXTURE_FILTER_POINT);
+    }
+
+    BeginTextureMode(spriteAtlas);
+    ClearBackground(BLANK);
+
+    float cy = spriteSize / 2.0f;
+    float segmentRadius = cellSize / 2.0f;
+
+    // body
+    DrawCircleV((Vector2){SPRITE_BODY * spriteSize + cy, cy}, segmentRadius - 1, cSnake);
+
+    // one head per direction
+    const char dirs[] = {'R', 'L', 'U', 'D'};
+    for (int i = 0; i < 4; i++)
+        DrawHeadSprite((SPRITE_HEAD_R + i) * spriteSize + cy, cy, dirs[i], cSnake);
 
     // apple parts
+    float fruitPixelX = SPRITE_FOOD * spriteSize + cy;
+    float fruitPixelY = cy;
+    float fruitRadius = cellSize / 2.0f - 4;
     DrawLineEx((Vector2){fruitPixelX, fruitPixelY - fruitRadius}, (Vector2){fruitPixelX, fruitPixelY - fruitRadius - 10}, 3, BROWN);
     DrawEllipse(fruitPixelX + 6, fruitPixelY - fruitRadius - 5, 6, 3, GREEN);
     DrawCircleV((Vector2){fruitPixelX, fruitPixelY}, fruitRadius, cFood);
+    EndTextureMode();
 
-    // draw snake
-    for (int i = game.snakeLength - 1; i >= 0; i--)
+    spriteAtlasTheme = (int)game.theme;
+}
+
+// how far we are between the last tick and the next one, 1 = draw the
+// current positions as they are
+float MotionAlpha(const GameState &game)
+{
+    if (!smoothMotion || game.gameOver || game.isLevelTransitioning)
+        return 1.0f;
+    float alpha = game.moveTimer / game.moveInterval;
+    return alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+}
+
+// queues one sprite centered on a board cell, must be called between rlBegin(RL_QUADS) and rlEnd.
+// cells are floats so segments can be drawn part way between two cells
+void DrawSpriteQuad(int slot, float cellX, float cellY)
+{
+    // flushes the batch if it is full, keeping the texture and mode
+    rlCheckRenderBatchLimit(4);
+
+    float x0 = boardOffsetX + cellX * cellSize + cellSize / 2.0f - spriteSize / 2.0f;
+    float y0 = boardOffsetY + cellY * cellSize + cellSize / 2.0f - spriteSize / 2.0f;
+    float x1 = x0 + spriteSize;
+    float y1 = y0 + spriteSize;
+    float u0 = (float)slot / SPRITE_COUNT;
+    float u1 = (float)(slot + 1) / SPRITE_COUNT;
+
+    // render textures are upside down, so the top of the sprite is v = 1
+    rlTexCoord2f(u0, 1.0f);
+    rlVertex2f(x0, y0);
+    rlTexCoord2f(u0, 0.0f);
+    rlVertex2f(x0, y1);
+    rlTexCoord2f(u1, 0.0f);
+    rlVertex2f(x1, y1);
+    rlTexCoord2f(u1, 1.0f);
+    rlVertex2f(x1, y0);
+}
+
+const ThemeColors &GetThemeColors(Theme theme)
+{
+    return themeColors[theme];
+}
+
+// measures the fixed lines, the default font only exists once the window does
+void LayoutFixedText()
+{
+    for (TextLabel &label : fixedText)
     {
-        float snakePixelX = boardOffsetX + game.snakePosition[i][0] * cellSize + cellSize / 2.0f;
-        float snakePixelY = boardOffsetY + game.snakePosition[i][1] * cellSize + cellSize / 2.0f;
-        float segmentRadius = cellSize / 2.0f;
+        label.width = MeasureText(label.text, label.fontSize);
+        label.ready = true;
+    }
+}
 
-        if (i == 0) // head
-        {
-            DrawCircleV((Vector2){snakePixelX, snakePixelY}, segmentRadius, cSnake);
+// formats and measures label again only when key changed since the last call
+const TextLabel &UpdateLabel(TextLabel &label, long long key, int fontSize, const char *format, ...)
+{
+    if (label.ready && label.key == key && label.fontSize == fontSize)
+        return label;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(label.text, sizeof(label.text), format, args);
+    va_end(args);
+    label.fontSize = fontSize;
+    label.width = MeasureText(label.text, fontSize);
+    label.key = key;
+    label.ready = true;
+    return label;
+}
 
-            // eye calc
-            float eyeOffsetX = 0;
-            float eyeOffsetY = 0;
-            float eyeSep = 8;
+void DrawCentered(const TextLabel &label, int y, Color color)
+{
+    DrawText(label.text, screenWidth / 2 - label.width / 2, y, label.fontSize, color);
+}
 
-            switch (game.key)
-            {
-            case 'R':
-                eyeOffsetX = eyeSep;
-                break;
-            case 'L':
-                eyeOffsetX = -eyeSep;
-                break;
-            case 'U':
-                eyeOffsetY = -eyeSep;
-                break;
-            case 'D':
-                eyeOffsetY = eyeSep;
-                break;
-            }
+// redraws the board layer and sprite atlas if they are out of date. both use
+// texture mode, which doesn't nest, so code drawing into a texture of its
+// own calls this first
+void UpdateDrawLayers(GameState &game)
+{
+    const ThemeColors &colors = GetThemeColors(game.theme);
+    if (boardLayer.id == 0 || boardLayerTheme != (int)game.theme || boardLayerMode != (int)game.currentMode ||
+        boardLayerLevel != game.storyLevel || boardLayerSeed != game.levelSeed || boardLayerDensity != game.levelDensity ||
+        boardLayerWidth != screenWidth || boardLayerHeight != screenHeight)
+    {
+        RedrawBoardLayer(game, colors.menuBg, colors.bg, colors.grid);
+    }
+    if (spriteAtlas.id == 0 || spriteAtlasTheme != (int)game.theme)
+        RedrawSpriteAtlas(game, colors.snake, colors.food);
+}
 
-            Vector2 leftEye, rightEye;
-            if (game.key == 'U' || game.key == 'D')
+void DrawGameplay(GameState &game)
+{
+    // static layer, one textured quad (render textures are stored upside down)
+    {
+        ProfileZone zone(ZONE_BOARD);
+        UpdateDrawLayers(game);
+        DrawTextureRec(boardLayer.texture, (Rectangle){0, 0, (float)boardLayer.texture.width, (float)-boardLayer.texture.height}, (Vector2){0, 0}, WHITE);
+    }
+
+    // food and snake come from the sprite atlas as one batch of quads
+    rlSetTexture(spriteAtlas.texture.id);
+    rlBegin(RL_QUADS);
+    rlColor4ub(255, 255, 255, 255);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+
+    // draw food (none left once the board is full)
+    if (game.foodX >= 0)
+    {
+        ProfileZone zone(ZONE_FOOD);
+        DrawSpriteQuad(SPRITE_FOOD, game.foodX, game.foodY);
+    }
+
+    {
+        ProfileZone zone(ZONE_SNAKE);
+
+        // draw snake, tail first so the head ends up on top. every segment
+        // slides from the cell the one behind it holds now (the tail from where
+        // it was) to its own cell, except across a wrap where it just snaps
+        float alpha = MotionAlpha(game);
+        int length = game.snake.Length();
+        for (int i = length - 1; i >= 0; i--)
+        {
+            const Cell &to = game.snake.At(i);
+            const Cell &from = i + 1 < length ? game.snake.At(i + 1) : tailFrom;
+            float x = (float)to.x;
+            float y = (float)to.y;
+            int dx = to.x - from.x;
+            int dy = to.y - from.y;
+            if (alpha < 1.0f && dx >= -1 && dx <= 1 && dy >= -1 && dy <= 1)
             {
-                leftEye = {snakePixelX - 6, snakePixelY + eyeOffsetY};
-                rightEye = {snakePixelX + 6, snakePixelY + eyeOffsetY};
+                x = from.x + dx * alpha;
+                y = from.y + dy * alpha;
             }
-            else
+
+            int sprite = SPRITE_BODY;
+            if (i == 0)
             {
-                leftEye = {snakePixelX + eyeOffsetX, snakePixelY - 6};
-                rightEye = {snakePixelX + eyeOffsetX, snakePixelY + 6};
+                sprite = SPRITE_HEAD_R;
+                if (game.key == 'L')
+                    sprite = SPRITE_HEAD_L;
+                else if (game.key == 'U')
+                    sprite = SPRITE_HEAD_U;
+                else if (game.key == 'D')
+                    sprite = SPRITE_HEAD_D;
             }
-
-            // draw eyes
-            DrawCircleV(leftEye, 5, WHITE);
-            DrawCircleV(rightEye, 5, WHITE);
-            DrawCircleV(leftEye, 2, BLACK);
-            DrawCircleV(rightEye, 2, BLACK);
+            DrawSpriteQuad(sprite, x, y);
         }
-        else // body
-        {
-            DrawCircleV((Vector2){snakePixelX, snakePixelY}, segmentRadius - 1, cSnake);
-        }
-    }
 
-    // walls
-    if (wallsActive)
-    {
-        DrawRectangleLinesEx((Rectangle){(float)boardOffsetX, (float)boardOffsetY, (float)boardWidth, (float)boardHeight}, 4, RED);
+        rlEnd();
+        rlSetTexture(0);
     }
 
     // UI text
-    DrawText(TextFormat("Score: %i", game.score), 20, 20, 30, WHITE);
+    ProfileZone hudZone(ZONE_HUD);
+    DrawText(UpdateLabel(scoreLabel, game.score, 30, "Score: %i", game.score).text, 20, 20, 30, WHITE);
 
-    std::string mText;
-    Color mColor;
+    // story shows its level next to the mode
+    long long modeKey = (long long)game.currentMode << 32 | (uint32_t)game.storyLevel;
+    if (game.currentMode == STORY)
+        UpdateLabel(modeLabel, modeKey, 30, "%s - LVL %i", modeHudNames[game.currentMode], game.storyLevel);
+    else
+        UpdateLabel(modeLabel, modeKey, 30, "%s", modeHudNames[game.currentMode]);
+    DrawCentered(modeLabel, 20, modeHudColors[game.currentMode]);
 
-    switch (game.currentMode)
+    if (autopilot.mode != AUTOPILOT_OFF)
     {
-    case EASY:
-        mText = "EASY";
-        mColor = GREEN;
-        break;
-    case NORMAL:
-        mText = "NORMAL";
-        mColor = ORANGE;
-        break;
-    case HARD:
-        mText = "HARD";
-        mColor = RED;
-        break;
-    case STORY:
-        mText = "STORY - LVL " + std::to_string(game.storyLevel);
-        mColor = SKYBLUE;
-        break;
+        const TextLabel &apText = UpdateLabel(autopilotLabel, autopilot.mode, 20, "AUTOPILOT: %s", AutopilotModeName(autopilot.mode));
+        DrawText(apText.text, screenWidth - apText.width - 20, 25, 20, GOLD);
     }
 
-    DrawText(mText.c_str(), screenWidth / 2 - MeasureText(mText.c_str(), 30) / 2, 20, 30, mColor);
+    if (rewinding)
+        DrawCentered(fixedText[TEXT_REWIND], screenHeight - 55, SKYBLUE);
 
     // level transition
     if (game.isLevelTransitioning)
     {
         DrawRectangle(0, 0, screenWidth, screenHeight, Color{0, 0, 0, 100});
-        std::string levelMsg = "LEVEL " + std::to_string(game.storyLevel);
-        DrawText(levelMsg.c_str(), screenWidth / 2 - MeasureText(levelMsg.c_str(), 60) / 2, screenHeight / 2 - 100, 60, GOLD);
-        std::string countStr = std::to_string((int)ceil(game.transitionTimer));
-        DrawText(countStr.c_str(), screenWidth / 2 - MeasureText(countStr.c_str(), 80) / 2, screenHeight / 2, 80, WHITE);
-        DrawText("Get Ready!", screenWidth / 2 - MeasureText("Get Ready!", 30) / 2, screenHeight / 2 + 80, 30, LIGHTGRAY);
+        DrawCentered(UpdateLabel(levelLabel, game.storyLevel, 60, "LEVEL %i", game.storyLevel), screenHeight / 2 - 100, GOLD);
+        const char *levelName = game.level ? game.level->name.c_str() : "";
+        DrawCentered(UpdateLabel(levelNameLabel, (long long)(intptr_t)game.level, 30, "%s", levelName), screenHeight / 2 - 35, GOLD);
+        int count = (int)ceil(game.transitionTimer);
+        DrawCentered(UpdateLabel(countdownLabel, count, 80, "%i", count), screenHeight / 2, WHITE);
+        DrawCentered(fixedText[TEXT_GET_READY], screenHeight / 2 + 80, LIGHTGRAY);
     }
 
     // game over screen
     if (game.gameOver)
     {
-        DrawText("GAME OVER", screenWidth / 2 - MeasureText("GAME OVER", 60) / 2, screenHeight / 2 - 60, 60, RED);
-        DrawText("Press ESC for Menu", screenWidth / 2 - MeasureText("Press ESC for Menu", 20) / 2, screenHeight / 2 + 10, 20, LIGHTGRAY);
-        DrawText("Press 'R' to RESTART", screenWidth / 2 - MeasureText("Press 'R' to RESTART", 25) / 2, screenHeight / 2 + 40, 25, GOLD);
+        if (game.gameWon)
+            DrawCentered(fixedText[TEXT_YOU_WIN], screenHeight / 2 - 60, GOLD);
+        else
+            DrawCentered(fixedText[TEXT_GAME_OVER], screenHeight / 2 - 60, RED);
+        DrawCentered(fixedText[TEXT_ESC_HINT], screenHeight / 2 + 10, LIGHTGRAY);
+        DrawCentered(fixedText[TEXT_RESTART_HINT], screenHeight / 2 + 40, GOLD);
+        DrawCentered(fixedText[TEXT_REWIND_HINT], screenHeight / 2 + 75, LIGHTGRAY);
+    }
+}
+
+// STATS OVERLAY
+
+// fps, input lag, heap use, the last frames as bars and p50/p99 of every zone
+void DrawStatsOverlay()
+{
+    const int w = 360;
+    const int x = screenWidth - w - 10;
+    int y = 10;
+    int rows = 5 + ZONE_COUNT;
+    DrawRectangle(x, y, w, 80 + rows * 18, (Color){0, 0, 0, 170});
+
+    DrawText(TextFormat("%i fps  input lag %.0f ms (avg %.0f, max %.0f)", GetFPS(), lastInputLatency, avgInputLatency, maxInputLatency), x + 8, y + 6, 10, WHITE);
+    y += 22;
+
+    // a frame where nothing happened should never touch the heap, only
+    // saves, level changes and the like do
+    int frames = ProfiledFrameCount();
+    int allocFrames = 0;
+    int maxAllocs = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        int allocs = ProfiledFrameAllocs(i);
+        allocFrames += allocs > 0;
+        maxAllocs = allocs > maxAllocs ? allocs : maxAllocs;
+    }
+    DrawText(TextFormat("heap allocs %i last frame, max %i, %i of %i frames", ProfiledFrameAllocs(0), maxAllocs, allocFrames, frames),
+             x + 8, y, 10, allocFrames > 0 ? ORANGE : WHITE);
+    y += 18;
+
+    // frame time bars, newest on the right, the line is 60 fps
+    const int graphH = 50;
+    const float graphMs = 33.3f;
+    float barW = (float)(w - 16) / profileFrames;
+    for (int i = 0; i < frames; i++)
+    {
+        float ms = ProfiledFrameTime(i);
+        int h = (int)(ms / graphMs * graphH);
+        if (h > graphH)
+            h = graphH;
+        Color c = ms > 16.7f ? ORANGE : GREEN;
+        DrawRectangle(x + 8 + (int)((profileFrames - 1 - i) * barW), y + graphH - h, (int)barW + 1, h, c);
+    }
+    int line60 = y + graphH - (int)(16.7f / graphMs * graphH);
+    DrawLine(x + 8, line60, x + w - 8, line60, LIGHTGRAY);
+    y += graphH + 8;
+
+    DrawText("zone            p50 ms   p99 ms", x + 8, y, 10, LIGHTGRAY);
+    y += 18;
+    for (int zone = -1; zone < ZONE_COUNT; zone++)
+    {
+        DrawText(ProfileZoneName(zone), x + 8, y, 10, WHITE);
+        DrawText(TextFormat("%7.3f  %7.3f", ProfilePercentile(zone, 50.0f), ProfilePercentile(zone, 99.0f)), x + 110, y, 10, WHITE);
+        y += 18;
+    }
+    DrawText(TextFormat("F4 writes %s", traceFilePath), x + 8, y, 10, LIGHTGRAY);
+}
+
+// BENCHMARK
+
+// renders gameplay frames with longer and longer snakes as fast as possible
+// and prints the average frame time for each length
+void RunRenderBenchmark(GameState &game)
+{
+    const int lengths[] = {4, 64, 512, 4096, 32768, 131072};
+    const int frames = 120;
+
+    SetTargetFPS(0);
+    game.stateofgame = 2;
+    game.currentMode = EASY;
+
+    printf("length,frame_ms,fps,allocs_per_frame\n");
+    for (int length : lengths)
+    {
+        // lay the body out row by row, back and forth; once the board is
+        // covered it keeps going over itself, which costs the same to draw
+        int cells = gridCountX * gridCountY;
+        game.snake.Clear();
+        for (int i = 0; i < length; i++)
+        {
+            int c = i % cells;
+            int row = c / gridCountX;
+            int col = (row % 2 == 0) ? c % gridCountX : gridCountX - 1 - c % gridCountX;
+            game.snake.PushTail(col, row);
+        }
+
+        // warm up so the atlas and board layer are already built
+        for (int f = 0; f < 5; f++)
+        {
+            BeginDrawing();
+            DrawGameplay(game);
+            EndDrawing();
+        }
+
+        double start = GetTime();
+        long long allocsBefore = ThreadAllocations();
+        for (int f = 0; f < frames; f++)
+        {
+            BeginDrawing();
+            DrawGameplay(game);
+            EndDrawing();
+        }
+        double ms = (GetTime() - start) * 1000.0 / frames;
+        double allocs = (double)(ThreadAllocations() - allocsBefore) / frames;
+        printf("%d,%.3f,%.1f,%.2f\n", length, ms, 1000.0 / ms, allocs);
+    }
+}
+
+// package energy counter from linux powercap, -1 where there is none or
+// it can't be read
+double ReadEnergyJoules()
+{
+    FILE *f = fopen("/sys/class/powercap/intel-rapl:0/energy_uj", "r");
+    if (!f)
+        return -1.0;
+    unsigned long long uj = 0;
+    bool ok = fscanf(f, "%llu", &uj) == 1;
+    fclose(f);
+    return ok ? uj / 1e6 : -1.0;
+}
+
+// sits on each idle screen for a few seconds with the throttle on and off
+// and prints how many frames were drawn and what that cost in cpu time
+// (every thread of the process) and, where linux exposes it, power
+void RunIdleBenchmark(GameState &game)
+{
+    const double seconds = 5.0;
+    const char *screens[] = {"menu", "game_over", "countdown"};
+
+    // the game over screen would delete the save otherwise
+    game.hasSaveFile = false;
+
+    printf("screen,throttle,seconds,frames_drawn,loops,cpu_percent,watts\n");
+    for (int screen = 0; screen < 3; screen++)
+    {
+        for (int throttle = 1; throttle >= 0; throttle--)
+        {
+            game.currentMode = screen == 2 ? STORY : NORMAL;
+            ResetGame(game, true);
+            game.stateofgame = screen == 0 ? 0 : 2;
+            game.gameOver = screen == 1;
+            game.isLevelTransitioning = screen == 2;
+            game.transitionTimer = screen == 2 ? 1000.0f : 0.0f;
+            idleThrottle = throttle == 1;
+            lastScreenKey = 0;
+
+            long long loops = 0;
+            long long drawn = 0;
+            double energyStart = ReadEnergyJoules();
+            std::clock_t cpuStart = std::clock();
+            double start = GetTime();
+            lastFrameStart = start;
+            while (GetTime() - start < seconds)
+            {
+                drawn += RunFrame(game);
+                loops++;
+            }
+            double wall = GetTime() - start;
+            double cpu = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+            double energyEnd = ReadEnergyJoules();
+
+            char watts[32] = "n/a";
+            if (energyStart >= 0.0 && energyEnd > energyStart)
+                snprintf(watts, sizeof(watts), "%.2f", (energyEnd - energyStart) / wall);
+            printf("%s,%s,%.1f,%lld,%lld,%.1f,%s\n", screens[screen], throttle ? "on" : "off", wall, drawn, loops,
+                   cpu / wall * 100.0, watts);
+            fflush(stdout);
+        }
     }
+    idleThrottle = true;
+}
+
+// a game state the offscreen benchmark draws
+struct OffscreenScene
+{
+    const char *name;
+    int stateofgame; // 0 menu, 2 playing
+    GameMode mode;
+    Theme theme;
+    float fill; // share of the board under the snake
+    bool gameOver;
+    bool transition;
+};
+
+const OffscreenScene offscreenScenes[] = {
+    {"menu_classic", 0, NORMAL, THEME_CLASSIC, 0.0f, false, false},
+    {"menu_desert", 0, MAZE, THEME_DESERT, 0.0f, false, false},
+    {"short_snake_classic", 2, NORMAL, THEME_CLASSIC, 0.0f, false, false},
+    {"long_snake_desert", 2, EASY, THEME_DESERT, 0.9f, false, false},
+    {"hurdles_classic", 2, HARD, THEME_CLASSIC, 0.3f, false, false},
+    {"maze_desert", 2, MAZE, THEME_DESERT, 0.3f, false, false},
+    {"level_up_classic", 2, STORY, THEME_CLASSIC, 0.1f, false, true},
+    {"game_over_desert", 2, NORMAL, THEME_DESERT, 0.5f, true, false}};
+
+// puts the game in scene, the same way every time
+void SetupOffscreenScene(GameState &game, const OffscreenScene &scene)
+{
+    game.currentMode = scene.mode;
+    game.theme = scene.theme;
+    game.mazeDensity = 0.7f;
+    SeedRandom(game, 1);
+    ResetGame(game, true);
+    if (scene.transition && StoryLevels(game).levels.size() > 1)
+    {
+        game.storyLevel = 2;
+        EnterLevel(game);
+    }
+
+    // back and forth over the rows from the top left, around any hurdles
+    int cells = gridCountX * gridCountY;
+    int length = (int)(cells * scene.fill);
+    length = length < 4 ? 4 : length;
+    bool hurdles = HurdlesActive(game);
+    game.snake.Clear();
+    for (int c = 0; c < cells && game.snake.Length() < length; c++)
+    {
+        int row = c / gridCountX;
+        int col = (row % 2 == 0) ? c % gridCountX : gridCountX - 1 - c % gridCountX;
+        if (!hurdles || !game.hurdleCells.Test(col, row))
+            game.snake.PushTail(col, row);
+    }
+    game.key = 'R';
+    RebuildOccupancy(game);
+    SpawnFood(game);
+
+    game.stateofgame = scene.stateofgame;
+    game.menuOption = 2;
+    game.score = 120;
+    game.highscore = 350;
+
+    // made up runs in place of whatever this machine played
+    for (auto &top : leaderboard.modes)
+        top.clear();
+    for (int i = 0; i < leaderboardShown; i++)
+    {
+        LeaderboardEntry entry;
+        entry.mode = scene.mode;
+        entry.score = 350 - i * 40;
+        entry.length = entry.score / 10 + 4;
+        entry.durationMs = 95000 - i * 7000;
+        InsertLeaderboardEntry(leaderboard, entry);
+    }
+    game.hasSaveFile = false;
+    game.gameOver = scene.gameOver;
+    game.gameWon = false;
+    game.isLevelTransitioning = scene.transition;
+    game.transitionTimer = 2.5f;
+    autopilot.mode = AUTOPILOT_OFF;
+    smoothMotion = false;
+    rewinding = false;
+}
+
+void DrawOffscreenFrame(GameState &game, RenderTexture2D target)
+{
+    UpdateDrawLayers(game);
+    BeginTextureMode(target);
+    if (game.stateofgame == 0)
+        DrawMenu(game);
+    else
+        DrawGameplay(game);
+    EndTextureMode();
+}
+
+// draws every scene into a texture with no window on screen and prints the
+// frame rate as csv. with pngDir each scene's last frame is written there
+// as <scene>.png for comparing against known good images. needs an OpenGL
+// context but no monitor, e.g. Mesa's llvmpipe under Xvfb on a CI box
+int RunOffscreenBenchmark(GameState &game, const char *pngDir)
+{
+    const int frames = 120;
+    RenderTexture2D target = LoadRenderTexture(screenWidth, screenHeight);
+    int status = 0;
+
+    printf("scene,frames,frame_ms,fps\n");
+    for (const OffscreenScene &scene : offscreenScenes)
+    {
+        SetupOffscreenScene(game, scene);
+        for (int f = 0; f < 3; f++)
+            DrawOffscreenFrame(game, target);
+
+        // reading the texture back waits for the gpu, before and after
+        Image image = LoadImageFromTexture(target.texture);
+        UnloadImage(image);
+        double start = GetTime();
+        for (int f = 0; f < frames; f++)
+            DrawOffscreenFrame(game, target);
+        image = LoadImageFromTexture(target.texture);
+        double ms = (GetTime() - start) * 1000.0 / frames;
+        printf("%s,%d,%.3f,%.1f\n", scene.name, frames, ms, 1000.0 / ms);
+        fflush(stdout);
+
+        // render textures are stored upside down
+        if (pngDir)
+        {
+            ImageFlipVertical(&image);
+            const char *path = TextFormat("%s/%s.png", pngDir, scene.name);
+            if (!ExportImage(image, path))
+            {
+                printf("could not write %s\n", path);
+                status = 1;
+            }
+        }
+        UnloadImage(image);
+    }
+
+    UnloadRenderTexture(target);
+    return status;
+}
+
+// REPLAY VIEWER
+
+// plays a recorded game in the window. space pauses, up/down change the
+// speed, left/right jump 100 ticks back/forward, esc quits
+void RunReplayViewer(GameState &game, const char *path)
+{
+    Replay rec;
+    if (!ReadReplayFile(path, rec))
+    {
+        printf("could not read replay %s\n", path);
+        return;
+    }
+    if (rec.gridCountX != gridCountX || rec.gridCountY != gridCountY)
+    {
+        printf("replay was recorded on a %dx%d board, this screen fits %dx%d\n", rec.gridCountX, rec.gridCountY, gridCountX, gridCountY);
+        return;
+    }
+    if (!ReplayMatchesLevels(rec, StoryLevels(game)))
+    {
+        printf("replay was recorded on other story levels than %s\n", game.levels ? levelFilePath : "the built in ones");
+        return;
+    }
+
+    ReplayPlayer *player = new ReplayPlayer();
+    player->game.theme = game.theme;
+    player->game.levels = game.levels;
+    StartPlayback(*player, rec, 256);
+
+    float speed = 1.0f;
+    float timer = 0.0f;
+    bool paused = false;
+    while (!IsKeyPressed(KEY_ESCAPE))
+    {
+        if (IsKeyPressed(KEY_SPACE))
+            paused = !paused;
+        if (IsKeyPressed(KEY_UP) && speed < 64.0f)
+            speed *= 2.0f;
+        if (IsKeyPressed(KEY_DOWN) && speed > 0.25f)
+            speed /= 2.0f;
+        if (IsKeyPressed(KEY_RIGHT))
+            SeekPlayback(*player, player->tick + 100);
+        if (IsKeyPressed(KEY_LEFT))
+            SeekPlayback(*player, player->tick > 100 ? player->tick - 100 : 0);
+
+        if (!paused)
+        {
+            timer += GetFrameTime() * speed;
+            while (timer >= player->game.moveInterval && !PlaybackFinished(*player))
+            {
+                timer -= player->game.moveInterval;
+                PlaybackStep(*player);
+            }
+            if (PlaybackFinished(*player))
+                timer = 0.0f;
+        }
+
+        BeginDrawing();
+        DrawGameplay(player->game);
+        DrawText(TextFormat("REPLAY  %u / %u  x%.2f%s", player->tick, rec.tickCount, speed, paused ? "  PAUSED" : ""), 20, 60, 20, WHITE);
+        EndDrawing();
+    }
+    delete player;
+}
+
+// ARENA
+
+// hundreds of bot snakes on one board with small cells. space pauses,
+// up/down change the speed, t switches the theme, esc quits
+void RunArenaView(GameState &game, int snakeCount)
+{
+    const int arenaCell = 4;
+    const float tickInterval = 0.1f;
+    int w = boardWidth / arenaCell;
+    int h = boardHeight / arenaCell;
+    if (snakeCount < 1)
+        snakeCount = 1;
+
+    Arena *arena = new Arena();
+    InitArena(*arena, w, h, snakeCount, snakeCount, (uint64_t)time(nullptr));
+
+    // one pixel per cell, rewritten every frame and drawn scaled up as a single quad
+    Image image = GenImageColor(w, h, BLACK);
+    Texture2D texture = LoadTextureFromImage(image);
+    SetTextureFilter(texture, TEXTURE_FILTER_POINT);
+    Color *pixels = (Color *)image.data;
+
+    float speed = 1.0f;
+    float timer = 0.0f;
+    bool paused = false;
+    ArenaTickStats last;
+    while (!IsKeyPressed(KEY_ESCAPE))
+    {
+        if (IsKeyPressed(KEY_SPACE))
+            paused = !paused;
+        if (IsKeyPressed(KEY_UP) && speed < 64.0f)
+            speed *= 2.0f;
+        if (IsKeyPressed(KEY_DOWN) && speed > 0.25f)
+            speed /= 2.0f;
+        if (IsKeyPressed(KEY_T))
+            game.theme = (Theme)((game.theme + 1) % THEME_COUNT);
+
+        if (!paused)
+        {
+            timer += GetFrameTime() * speed;
+            for (int ticks = 0; timer >= tickInterval; ticks++)
+            {
+                if (ticks == maxTicksPerFrame)
+                {
+                    timer = fmodf(timer, tickInterval);
+                    break;
+                }
+                timer -= tickInterval;
+                last = StepArena(*arena);
+            }
+        }
+
+        const ThemeColors &colors = GetThemeColors(game.theme);
+        for (int i = 0; i < w * h; i++)
+        {
+            int owner = arena->owner[i];
+            pixels[i] = owner > 0 ? colors.snake : (owner < 0 ? colors.food : colors.bg);
+        }
+        UpdateTexture(texture, pixels);
+
+        int longest = 0;
+        for (const ArenaSnake &snake : arena->snakes)
+            longest = snake.body.Length() > longest ? snake.body.Length() : longest;
+
+        BeginDrawing();
+        ClearBackground(colors.menuBg);
+        DrawTexturePro(texture, (Rectangle){0, 0, (float)w, (float)h},
+                       (Rectangle){(float)boardOffsetX, (float)boardOffsetY, (float)(w * arenaCell), (float)(h * arenaCell)},
+                       (Vector2){0, 0}, 0.0f, WHITE);
+        DrawRectangleLinesEx((Rectangle){(float)boardOffsetX, (float)boardOffsetY, (float)(w * arenaCell), (float)(h * arenaCell)}, 4, RED);
+        DrawText(TextFormat("ARENA  tick %u  alive %i / %i  longest %i  died %i  x%.2f%s", arena->tick, ArenaAliveCount(*arena),
+                            snakeCount, longest, last.died, speed, paused ? "  PAUSED" : ""),
+                 20, 20, 20, WHITE);
+        EndDrawing();
+    }
+
+    UnloadTexture(texture);
+    UnloadImage(image);
+    delete arena;
 }
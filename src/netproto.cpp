@@ -0,0 +1,459 @@
+#include "netproto.h"
+
+#include <algorithm>
+#include <vector>
+
+// snake numbers above this are treated as garbage
+static const uint64_t maxSnakes = 1 << 20;
+
+static void PutU32(std::string &out, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back((char)((v >> (i * 8)) & 0xFF));
+}
+
+static void PutU64(std::string &out, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+        out.push_back((char)((v >> (i * 8)) & 0xFF));
+}
+
+static void PutVarint(std::string &out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back((char)((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+// reads from a payload, every getter fails once the end is passed
+struct Reader
+{
+    const unsigned char *p;
+    const unsigned char *end;
+
+    bool U8(uint8_t &v)
+    {
+        if (end - p < 1)
+            return false;
+        v = *p++;
+        return true;
+    }
+
+    bool U32(uint32_t &v)
+    {
+        if (end - p < 4)
+            return false;
+        v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        p += 4;
+        return true;
+    }
+
+    bool U64(uint64_t &v)
+    {
+        uint32_t lo, hi;
+        if (!U32(lo) || !U32(hi))
+            return false;
+        v = (uint64_t)hi << 32 | lo;
+        return true;
+    }
+
+    bool Varint(uint64_t &v)
+    {
+        v = 0;
+        for (int shift = 0; shift < 64 && p < end; shift += 7)
+        {
+            unsigned char b = *p++;
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+};
+
+static int KeyCode(char key)
+{
+    switch (key)
+    {
+    case 'R':
+        return 0;
+    case 'L':
+        return 1;
+    case 'U':
+        return 2;
+    default:
+        return 3;
+    }
+}
+
+static const char codeKeys[] = {'R', 'L', 'U', 'D'};
+
+static bool IsKey(uint8_t key)
+{
+    return key == 'R' || key == 'L' || key == 'U' || key == 'D';
+}
+
+bool AppendMessage(std::string &out, uint8_t type, const std::string &payload)
+{
+    if (payload.size() + 1 > netMaxMessage)
+        return false;
+    PutU32(out, (uint32_t)payload.size() + 1);
+    out.push_back((char)type);
+    out += payload;
+    return true;
+}
+
+bool PeekMessage(const std::string &buffer, size_t offset, uint8_t &type, const unsigned char *&payload,
+                 size_t &size, size_t &next)
+{
+    const unsigned char *p = (const unsigned char *)buffer.data() + offset;
+    size_t have = buffer.size() - offset;
+    if (have < 5)
+        return false;
+    uint32_t length = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    if (have - 4 < length)
+        return false;
+    type = p[4];
+    payload = p + 5;
+    size = length - 1;
+    next = offset + 4 + length;
+    return true;
+}
+
+std::string EncodeWelcome(int snake, int width, int height, int tickRate)
+{
+    std::string out;
+    PutVarint(out, snake);
+    PutVarint(out, width);
+    PutVarint(out, height);
+    PutVarint(out, tickRate);
+    return out;
+}
+
+bool DecodeWelcome(const unsigned char *p, size_t size, int &snake, int &width, int &height, int &tickRate)
+{
+    Reader r = {p, p + size};
+    uint64_t s, w, h, t;
+    if (!r.Varint(s) || !r.Varint(w) || !r.Varint(h) || !r.Varint(t))
+        return false;
+    if (s >= maxSnakes || w < 1 || h < 1 || w > 65536 || h > 65536 || w * h > (1u << 28) || t < 1 || t > 1000)
+        return false;
+    snake = (int)s;
+    width = (int)w;
+    height = (int)h;
+    tickRate = (int)t;
+    return true;
+}
+
+std::string EncodeSnapshot(const Arena &arena)
+{
+    std::string out;
+    PutU32(out, arena.tick);
+    PutVarint(out, ArenaAliveCount(arena));
+
+    int prev = 0;
+    for (int i = 0; i < (int)arena.snakes.size(); i++)
+    {
+        const ArenaSnake &snake = arena.snakes[i];
+        if (!snake.alive)
+            continue;
+        const SnakeBody &body = snake.body;
+        PutVarint(out, i - prev);
+        prev = i;
+        PutVarint(out, body.Length());
+        PutVarint(out, body.Head().y * arena.width + body.Head().x);
+        out.push_back(snake.key);
+
+        unsigned char packed = 0;
+        for (int s = 1; s < body.Length(); s++)
+        {
+            int dx = body.At(s).x - body.At(s - 1).x;
+            int dy = body.At(s).y - body.At(s - 1).y;
+            int code = dx == 1 ? 0 : (dx == -1 ? 1 : (dy == -1 ? 2 : 3));
+            packed |= code << (((s - 1) & 3) * 2);
+            if (((s - 1) & 3) == 3 || s == body.Length() - 1)
+            {
+                out.push_back((char)packed);
+                packed = 0;
+            }
+        }
+    }
+
+    std::vector<int> foods(arena.foods);
+    std::sort(foods.begin(), foods.end());
+    PutVarint(out, foods.size());
+    prev = 0;
+    for (int cell : foods)
+    {
+        PutVarint(out, cell - prev);
+        prev = cell;
+    }
+    return out;
+}
+
+std::string EncodeTick(const Arena &arena, uint64_t sentAt)
+{
+    std::string out;
+    PutU32(out, arena.tick);
+    PutU64(out, sentAt);
+    PutU32(out, ArenaChecksum(arena));
+
+    // changes come out of StepArena spawns first, then moves and deaths, then food
+    size_t spawns = 0;
+    size_t foods = 0;
+    for (const ArenaChange &c : arena.changes)
+    {
+        spawns += c.kind == ARENA_SPAWN;
+        foods += c.kind == ARENA_FOOD;
+    }
+
+    PutVarint(out, spawns);
+    int prev = 0;
+    for (const ArenaChange &c : arena.changes)
+    {
+        if (c.kind != ARENA_SPAWN)
+            continue;
+        PutVarint(out, c.snake - prev);
+        prev = c.snake;
+        PutVarint(out, c.cell);
+        out.push_back(c.key);
+    }
+
+    PutVarint(out, arena.changes.size() - spawns - foods);
+    prev = 0;
+    for (const ArenaChange &c : arena.changes)
+    {
+        if (c.kind != ARENA_MOVE && c.kind != ARENA_DIE)
+            continue;
+        int code = c.kind == ARENA_DIE ? 8 : KeyCode(c.key) + (c.grew ? 4 : 0);
+        PutVarint(out, (uint64_t)(c.snake - prev) << 4 | code);
+        prev = c.snake;
+    }
+
+    PutVarint(out, foods);
+    for (const ArenaChange &c : arena.changes)
+    {
+        if (c.kind == ARENA_FOOD)
+            PutVarint(out, c.cell);
+    }
+    return out;
+}
+
+void AppendTickAck(std::string &payload, uint32_t lastTurn)
+{
+    PutU32(payload, lastTurn);
+}
+
+std::string EncodeTurn(uint32_t turn, char key)
+{
+    std::string out;
+    PutU32(out, turn);
+    out.push_back(key);
+    return out;
+}
+
+bool DecodeTurn(const unsigned char *p, size_t size, uint32_t &turn, char &key)
+{
+    Reader r = {p, p + size};
+    uint8_t k;
+    if (!r.U32(turn) || !r.U8(k) || !IsKey(k))
+        return false;
+    key = (char)k;
+    return true;
+}
+
+// grows the mirror's snake list to hold snake number index
+static ArenaSnake &MirrorSnake(Arena &mirror, size_t index)
+{
+    if (index >= mirror.snakes.size())
+        mirror.snakes.resize(index + 1);
+    return mirror.snakes[index];
+}
+
+// clears only cells the snake still owns, another head may already sit on its old tail
+static void ClearMirrorSnake(Arena &mirror, int index)
+{
+    ArenaSnake &snake = mirror.snakes[index];
+    for (int s = 0; s < snake.body.Length(); s++)
+    {
+        int cell = snake.body.At(s).y * mirror.width + snake.body.At(s).x;
+        if (mirror.owner[cell] == index + 1)
+            mirror.owner[cell] = 0;
+    }
+    snake.body.Clear();
+    snake.alive = false;
+}
+
+bool ApplySnapshot(Arena &mirror, int width, int height, const unsigned char *p, size_t size)
+{
+    Reader r = {p, p + size};
+    uint32_t tick;
+    uint64_t alive;
+    if (!r.U32(tick) || !r.Varint(alive) || alive > maxSnakes)
+        return false;
+
+    int cells = width * height;
+    mirror.width = width;
+    mirror.height = height;
+    mirror.tick = tick;
+    mirror.owner.assign(cells, 0);
+    mirror.snakes.clear();
+
+    uint64_t index = 0;
+    for (uint64_t n = 0; n < alive; n++)
+    {
+        uint64_t gap, length, head;
+        uint8_t key;
+        if (!r.Varint(gap) || !r.Varint(length) || !r.Varint(head) || !r.U8(key))
+            return false;
+        index += gap;
+        if (index >= maxSnakes || length < 1 || length > (uint64_t)cells || head >= (uint64_t)cells || !IsKey(key))
+            return false;
+        if ((uint64_t)(r.end - r.p) < (length - 1 + 3) / 4)
+            return false;
+
+        ArenaSnake &snake = MirrorSnake(mirror, index);
+        snake.alive = true;
+        snake.key = (char)key;
+        snake.body.Clear();
+        int x = (int)(head % width);
+        int y = (int)(head / width);
+        snake.body.PushTail(x, y);
+        mirror.owner[y * width + x] = (int32_t)index + 1;
+        for (uint64_t s = 1; s < length; s++)
+        {
+            int code = (r.p[(s - 1) >> 2] >> (((s - 1) & 3) * 2)) & 3;
+            x += code == 0 ? 1 : (code == 1 ? -1 : 0);
+            y += code == 2 ? -1 : (code == 3 ? 1 : 0);
+            if (x < 0 || x >= width || y < 0 || y >= height)
+                return false;
+            snake.body.PushTail(x, y);
+            mirror.owner[y * width + x] = (int32_t)index + 1;
+        }
+        r.p += (length - 1 + 3) / 4;
+    }
+
+    uint64_t foods;
+    if (!r.Varint(foods) || foods > (uint64_t)cells)
+        return false;
+    uint64_t cell = 0;
+    for (uint64_t n = 0; n < foods; n++)
+    {
+        uint64_t gap;
+        if (!r.Varint(gap))
+            return false;
+        cell += gap;
+        if (cell >= (uint64_t)cells)
+            return false;
+        mirror.owner[cell] = -1;
+    }
+    return r.p == r.end;
+}
+
+bool ApplyTick(Arena &mirror, const unsigned char *p, size_t size, TickInfo &info)
+{
+    Reader r = {p, p + size};
+    if (!r.U32(info.tick) || !r.U64(info.sentAt) || !r.U32(info.checksum))
+        return false;
+    mirror.tick = info.tick;
+    uint64_t cells = (uint64_t)mirror.width * mirror.height;
+
+    uint64_t count;
+    if (!r.Varint(count) || count > maxSnakes)
+        return false;
+    uint64_t index = 0;
+    for (uint64_t n = 0; n < count; n++)
+    {
+        uint64_t gap, cell;
+        uint8_t key;
+        if (!r.Varint(gap) || !r.Varint(cell) || !r.U8(key))
+            return false;
+        index += gap;
+        if (index >= maxSnakes || cell >= cells || !IsKey(key))
+            return false;
+        ArenaSnake &snake = MirrorSnake(mirror, index);
+        if (snake.alive)
+            ClearMirrorSnake(mirror, (int)index);
+        snake.alive = true;
+        snake.key = (char)key;
+        snake.body.PushHead((int)(cell % mirror.width), (int)(cell / mirror.width));
+        mirror.owner[cell] = (int32_t)index + 1;
+    }
+
+    if (!r.Varint(count) || count > maxSnakes)
+        return false;
+    index = 0;
+    for (uint64_t n = 0; n < count; n++)
+    {
+        uint64_t v;
+        if (!r.Varint(v))
+            return false;
+        index += v >> 4;
+        int code = (int)(v & 15);
+        if (index >= mirror.snakes.size() || !mirror.snakes[index].alive || code > 8)
+            return false;
+
+        ArenaSnake &snake = mirror.snakes[index];
+        if (code == 8)
+        {
+            ClearMirrorSnake(mirror, (int)index);
+            continue;
+        }
+
+        if (!(code & 4))
+        {
+            const Cell &tail = snake.body.Tail();
+            int cell = tail.y * mirror.width + tail.x;
+            if (mirror.owner[cell] == (int32_t)index + 1)
+                mirror.owner[cell] = 0;
+            snake.body.PopTail();
+        }
+        int x = snake.body.Length() > 0 ? snake.body.Head().x : 0;
+        int y = snake.body.Length() > 0 ? snake.body.Head().y : 0;
+        snake.key = codeKeys[code & 3];
+        x += snake.key == 'R' ? 1 : (snake.key == 'L' ? -1 : 0);
+        y += snake.key == 'U' ? -1 : (snake.key == 'D' ? 1 : 0);
+        if (snake.body.Length() == 0 || x < 0 || x >= mirror.width || y < 0 || y >= mirror.height)
+            return false;
+        snake.body.PushHead(x, y);
+        mirror.owner[y * mirror.width + x] = (int32_t)index + 1;
+    }
+
+    if (!r.Varint(count) || count > cells)
+        return false;
+    for (uint64_t n = 0; n < count; n++)
+    {
+        uint64_t cell;
+        if (!r.Varint(cell) || cell >= cells)
+            return false;
+        mirror.owner[cell] = -1;
+    }
+
+    return r.U32(info.lastTurn) && r.p == r.end;
+}
+
+uint32_t ArenaChecksum(const Arena &arena)
+{
+    // fnv-1a over snake number, head cell and length
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < (int)arena.snakes.size(); i++)
+    {
+        const ArenaSnake &snake = arena.snakes[i];
+        if (!snake.alive)
+            continue;
+        uint32_t values[3] = {(uint32_t)i, (uint32_t)(snake.body.Head().y * arena.width + snake.body.Head().x),
+                              (uint32_t)snake.body.Length()};
+        for (uint32_t v : values)
+        {
+            for (int b = 0; b < 4; b++)
+            {
+                hash ^= (v >> (b * 8)) & 0xFF;
+                hash *= 16777619u;
+            }
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,77 @@
+#ifndef NETPROTO_H
+#define NETPROTO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "arena.h"
+
+// wire format between the arena server and its clients. every message is
+//   u32 size of what follows, u8 type, payload
+// fixed width integers are little endian, counts, cells and snake numbers
+// are varints. snake numbers in a list are sent as the gap to the one before
+//
+//   HELLO    c->s  u8 protocol version
+//   WELCOME  s->c  varint your snake, varint width, varint height, varint ticks per second
+//   SNAPSHOT s->c  u32 tick, varint snakes alive, per snake: varint snake gap,
+//                  varint length, varint head cell, u8 key, body as 2 bit steps
+//                  four to a byte (0 R, 1 L, 2 U, 3 D toward the tail),
+//                  varint food count, varint gaps between sorted food cells
+//   TICK     s->c  u32 tick, u64 server clock (ns) when sent, u32 checksum,
+//                  varint spawns, per spawn: varint snake gap, varint cell, u8 key,
+//                  varint events, per event: varint (snake gap << 4 | code),
+//                  code 0-3 moved R/L/U/D, +4 if it grew, 8 died,
+//                  varint foods, per food varint cell,
+//                  u32 the newest turn of yours this tick took
+//   TURN     c->s  u32 turn number, u8 key
+//
+// a client only ever gets the snapshot once, when it joins; after that every
+// tick is just the heads, tails and food that changed
+const uint8_t netVersion = 1;
+const size_t netMaxMessage = 1 << 24;
+
+enum NetMessageType
+{
+    MSG_HELLO = 1,
+    MSG_WELCOME,
+    MSG_SNAPSHOT,
+    MSG_TICK,
+    MSG_TURN
+};
+
+// appends one message to out, false if the payload is too big to frame
+bool AppendMessage(std::string &out, uint8_t type, const std::string &payload);
+
+// the next whole message at the front of buffer, false until one has arrived
+bool PeekMessage(const std::string &buffer, size_t offset, uint8_t &type, const unsigned char *&payload,
+                 size_t &size, size_t &next);
+
+std::string EncodeWelcome(int snake, int width, int height, int tickRate);
+std::string EncodeSnapshot(const Arena &arena);
+
+// everything in a TICK except the per client turn number at the end
+std::string EncodeTick(const Arena &arena, uint64_t sentAt);
+void AppendTickAck(std::string &payload, uint32_t lastTurn);
+
+std::string EncodeTurn(uint32_t turn, char key);
+
+bool DecodeWelcome(const unsigned char *p, size_t size, int &snake, int &width, int &height, int &tickRate);
+bool DecodeTurn(const unsigned char *p, size_t size, uint32_t &turn, char &key);
+
+// a client's copy of the board, kept as an Arena with only the bodies and the
+// owner grid filled in. the decoders check every number before using it
+bool ApplySnapshot(Arena &mirror, int width, int height, const unsigned char *p, size_t size);
+
+struct TickInfo
+{
+    uint32_t tick;
+    uint64_t sentAt;
+    uint32_t checksum;
+    uint32_t lastTurn;
+};
+bool ApplyTick(Arena &mirror, const unsigned char *p, size_t size, TickInfo &info);
+
+// heads and lengths of every live snake, both ends compute it to catch drift
+uint32_t ArenaChecksum(const Arena &arena);
+
+#endif
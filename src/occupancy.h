@@ -0,0 +1,59 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// one bit per board cell, so "is anything here?" is a single lookup
+struct OccupancyGrid
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint64_t> bits;
+
+    void Resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        bits.assign(((size_t)w * h + 63) / 64, 0);
+    }
+
+    void ClearAll()
+    {
+        for (size_t i = 0; i < bits.size(); i++)
+            bits[i] = 0;
+    }
+
+    bool InBounds(int x, int y) const
+    {
+        return x >= 0 && x < width && y >= 0 && y < height;
+    }
+
+    // out of bounds cells count as empty, same as the old linear scans
+    bool Test(int x, int y) const
+    {
+        if (!InBounds(x, y))
+            return false;
+        size_t i = (size_t)y * width + x;
+        return (bits[i >> 6] >> (i & 63)) & 1;
+    }
+
+    void Set(int x, int y)
+    {
+        if (!InBounds(x, y))
+            return;
+        size_t i = (size_t)y * width + x;
+        bits[i >> 6] |= 1ull << (i & 63);
+    }
+
+    void Clear(int x, int y)
+    {
+        if (!InBounds(x, y))
+            return;
+        size_t i = (size_t)y * width + x;
+        bits[i >> 6] &= ~(1ull << (i & 63));
+    }
+};
+
+#endif
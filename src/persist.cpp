@@ -0,0 +1,180 @@
+#include "persist.h"
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <condition_variable>
+
+#ifdef _WIN32
+#include <io.h>
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// one pending operation per path, a newer request replaces an older one
+struct PendingWrite
+{
+    bool remove = false;
+    std::string contents;
+};
+
+static std::mutex persistMutex;
+static std::condition_variable persistWake;
+static std::condition_variable persistIdle;
+static std::map<std::string, PendingWrite> pending;
+static std::vector<std::function<void()>> tasks;
+static std::thread worker;
+static bool running = false;
+static bool busy = false;
+
+bool WriteFileAtomic(const std::string &path, const std::string &contents)
+{
+    std::string tmpPath = path + ".tmp";
+    FILE *f = fopen(tmpPath.c_str(), "wb");
+    if (!f)
+        return false;
+
+    bool ok = fwrite(contents.data(), 1, contents.size(), f) == contents.size();
+    ok = (fflush(f) == 0) && ok;
+
+    // make sure the bytes are on disk before the rename makes them visible
+#ifdef _WIN32
+    ok = (_commit(_fileno(f)) == 0) && ok;
+#else
+    ok = (fsync(fileno(f)) == 0) && ok;
+#endif
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok)
+    {
+        remove(tmpPath.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    return MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(tmpPath.c_str(), path.c_str()) == 0;
+#endif
+}
+
+static void PersistenceLoop()
+{
+    std::unique_lock<std::mutex> lock(persistMutex);
+    while (true)
+    {
+        persistWake.wait(lock, [] { return !pending.empty() || !tasks.empty() || !running; });
+        if (pending.empty() && tasks.empty() && !running)
+            break;
+
+        // take the whole batch and do the slow part without the lock
+        std::map<std::string, PendingWrite> batch;
+        batch.swap(pending);
+        std::vector<std::function<void()>> batchTasks;
+        batchTasks.swap(tasks);
+        busy = true;
+        lock.unlock();
+
+        for (auto &entry : batch)
+        {
+            if (entry.second.remove)
+                remove(entry.first.c_str());
+            else
+                WriteFileAtomic(entry.first, entry.second.contents);
+        }
+        for (auto &task : batchTasks)
+            task();
+
+        lock.lock();
+        busy = false;
+        if (pending.empty() && tasks.empty())
+            persistIdle.notify_all();
+    }
+    persistIdle.notify_all();
+}
+
+void StartPersistence()
+{
+    std::lock_guard<std::mutex> lock(persistMutex);
+    if (running)
+        return;
+    running = true;
+    worker = std::thread(PersistenceLoop);
+}
+
+void StopPersistence()
+{
+    {
+        std::lock_guard<std::mutex> lock(persistMutex);
+        if (!running)
+            return;
+        running = false;
+    }
+    persistWake.notify_one();
+    worker.join();
+}
+
+void FlushPersistence()
+{
+    std::unique_lock<std::mutex> lock(persistMutex);
+    persistIdle.wait(lock, [] { return (pending.empty() && tasks.empty() && !busy) || !running; });
+}
+
+void QueueFileWrite(const std::string &path, const std::string &contents)
+{
+    {
+        std::lock_guard<std::mutex> lock(persistMutex);
+        if (running)
+        {
+            PendingWrite &op = pending[path];
+            op.remove = false;
+            op.contents = contents;
+        }
+        else
+        {
+            // no worker, write it right here
+            WriteFileAtomic(path, contents);
+            return;
+        }
+    }
+    persistWake.notify_one();
+}
+
+void QueueFileRemove(const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(persistMutex);
+        if (running)
+        {
+            PendingWrite &op = pending[path];
+            op.remove = true;
+            op.contents.clear();
+        }
+        else
+        {
+            remove(path.c_str());
+            return;
+        }
+    }
+    persistWake.notify_one();
+}
+
+void QueueFileTask(std::function<void()> task)
+{
+    std::unique_lock<std::mutex> lock(persistMutex);
+    if (!running)
+    {
+        // no worker, run it right here. not under the lock, the task may queue more
+        lock.unlock();
+        task();
+        return;
+    }
+    tasks.push_back(std::move(task));
+    lock.unlock();
+    persistWake.notify_one();
+}
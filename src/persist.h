@@ -0,0 +1,24 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <functional>
+#include <string>
+
+// background file writer so the game loop never waits on the disk.
+// writes to the same path are coalesced, only the newest contents get
+// written, and every write goes to a temp file that is renamed over the
+// target so a crash never leaves a half written file behind
+void StartPersistence();
+void StopPersistence(); // writes whatever is still pending, then joins the worker
+void FlushPersistence(); // blocks until everything queued so far is on disk
+void QueueFileWrite(const std::string &path, const std::string &contents);
+void QueueFileRemove(const std::string &path);
+
+// any other slow file work, run on the worker in the order queued. without a
+// worker it runs right here
+void QueueFileTask(std::function<void()> task);
+
+// the write itself, also usable directly when no worker is running
+bool WriteFileAtomic(const std::string &path, const std::string &contents);
+
+#endif
@@ -0,0 +1,187 @@
+#include "profiler.h"
+#include "alloccount.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+struct ProfileEvent
+{
+    int zone;
+    int64_t start;
+    int64_t end;
+};
+
+// one frame of zones, the event list keeps its capacity between frames and
+// is reserved when profiling starts, so the profiler's own bookkeeping
+// doesn't show up in the allocation count of the frames it records
+struct ProfileFrame
+{
+    int64_t start = 0;
+    int64_t end = 0;
+    int64_t zoneTime[ZONE_COUNT]; // summed, a zone can run more than once a frame
+    int zoneRuns[ZONE_COUNT];
+    long long allocs = 0; // heap allocations on the main thread
+    std::vector<ProfileEvent> events;
+};
+
+bool profilerEnabled = false;
+
+static ProfileFrame frames[profileFrames];
+static int current = 0;  // slot of the frame being recorded
+static int recorded = 0; // finished frames in the ring
+static bool inFrame = false;
+
+static const char *zoneNames[ZONE_COUNT] = {
+    "update", "menu", "board", "grid", "hurdles", "food",
+    "snake", "hud", "save", "load", "highscore", "present"};
+
+int64_t ProfilerNow()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void SetProfilerEnabled(bool enabled)
+{
+    if (enabled && !profilerEnabled)
+    {
+        current = 0;
+        recorded = 0;
+        for (ProfileFrame &frame : frames)
+            frame.events.reserve(ZONE_COUNT * 4);
+    }
+    profilerEnabled = enabled;
+    inFrame = false;
+}
+
+void ProfilerBeginFrame()
+{
+    if (!profilerEnabled)
+        return;
+
+    ProfileFrame &frame = frames[current];
+    frame.start = ProfilerNow();
+    frame.end = frame.start;
+    for (int i = 0; i < ZONE_COUNT; i++)
+    {
+        frame.zoneTime[i] = 0;
+        frame.zoneRuns[i] = 0;
+    }
+    frame.events.clear();
+    frame.allocs = ThreadAllocations();
+    inFrame = true;
+}
+
+void ProfilerEndFrame()
+{
+    if (!inFrame)
+        return;
+
+    frames[current].end = ProfilerNow();
+    frames[current].allocs = ThreadAllocations() - frames[current].allocs;
+    current = (current + 1) % profileFrames;
+    if (recorded < profileFrames)
+        recorded++;
+    inFrame = false;
+}
+
+// zones outside a frame (startup loading) are dropped
+void ProfilerRecord(int zone, int64_t start, int64_t end)
+{
+    if (!inFrame)
+        return;
+
+    ProfileFrame &frame = frames[current];
+    frame.zoneTime[zone] += end - start;
+    frame.zoneRuns[zone]++;
+    frame.events.push_back({zone, start, end});
+}
+
+// finished frames still in the ring. once it is full, the slot of a frame
+// being recorded held the oldest one and doesn't count anymore
+static int CompletedFrames()
+{
+    return inFrame && recorded == profileFrames ? recorded - 1 : recorded;
+}
+
+const char *ProfileZoneName(int zone)
+{
+    return zone >= 0 && zone < ZONE_COUNT ? zoneNames[zone] : "frame";
+}
+
+int ProfiledFrameCount()
+{
+    return CompletedFrames();
+}
+
+float ProfiledFrameTime(int age)
+{
+    if (age < 0 || age >= CompletedFrames())
+        return 0.0f;
+    const ProfileFrame &frame = frames[(current - 1 - age + profileFrames) % profileFrames];
+    return (frame.end - frame.start) / 1e6f;
+}
+
+int ProfiledFrameAllocs(int age)
+{
+    if (age < 0 || age >= CompletedFrames())
+        return 0;
+    return (int)frames[(current - 1 - age + profileFrames) % profileFrames].allocs;
+}
+
+// only frames the zone ran in count, so a save every few seconds shows its
+// own cost instead of a p50 of zero
+float ProfilePercentile(int zone, float pct)
+{
+    float samples[profileFrames];
+    int n = 0;
+    int count = CompletedFrames();
+    for (int age = 0; age < count; age++)
+    {
+        const ProfileFrame &frame = frames[(current - 1 - age + profileFrames) % profileFrames];
+        if (zone < 0)
+            samples[n++] = (frame.end - frame.start) / 1e6f;
+        else if (frame.zoneRuns[zone] > 0)
+            samples[n++] = frame.zoneTime[zone] / 1e6f;
+    }
+    if (n == 0)
+        return 0.0f;
+
+    int k = (int)(pct / 100.0f * (n - 1) + 0.5f);
+    std::nth_element(samples, samples + k, samples + n);
+    return samples[k];
+}
+
+std::string ProfileTraceJson()
+{
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    int count = CompletedFrames();
+    if (count == 0)
+        return out + "]}\n";
+
+    int oldest = (current - count + profileFrames) % profileFrames;
+    int64_t origin = frames[oldest].start;
+    char line[160];
+    bool first = true;
+    for (int i = 0; i < count; i++)
+    {
+        const ProfileFrame &frame = frames[(oldest + i) % profileFrames];
+
+        // frame first, chrome nests the zones under it by time
+        snprintf(line, sizeof(line), "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                 first ? "" : ",\n", (frame.start - origin) / 1e3, (frame.end - frame.start) / 1e3);
+        out += line;
+        first = false;
+
+        for (const ProfileEvent &e : frame.events)
+        {
+            snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                     zoneNames[e.zone], (e.start - origin) / 1e3, (e.end - e.start) / 1e3);
+            out += line;
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
@@ -0,0 +1,64 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <string>
+
+// where frame time goes, measured per zone and kept for the last
+// profileFrames frames. while profiling is off every call is one branch
+enum ProfileZoneId
+{
+    ZONE_UPDATE = 0,
+    ZONE_MENU,
+    ZONE_BOARD,
+    ZONE_GRID,
+    ZONE_HURDLES,
+    ZONE_FOOD,
+    ZONE_SNAKE,
+    ZONE_HUD,
+    ZONE_SAVE,
+    ZONE_LOAD,
+    ZONE_HIGHSCORE,
+    ZONE_PRESENT, // EndDrawing, mostly the wait for vsync
+    ZONE_COUNT
+};
+
+const int profileFrames = 240;
+
+extern bool profilerEnabled;
+
+void SetProfilerEnabled(bool enabled); // turning it on starts from an empty history
+void ProfilerBeginFrame();
+void ProfilerEndFrame();
+int64_t ProfilerNow(); // ns
+void ProfilerRecord(int zone, int64_t start, int64_t end);
+
+const char *ProfileZoneName(int zone);
+int ProfiledFrameCount();
+float ProfiledFrameTime(int age); // ms, age 0 is the last finished frame
+int ProfiledFrameAllocs(int age);  // operator new calls on the thread running the frames
+
+// percentile in ms over the recorded frames, zone -1 is the whole frame
+float ProfilePercentile(int zone, float pct);
+
+// chrome://tracing / perfetto json of every recorded frame
+std::string ProfileTraceJson();
+
+// times the scope it lives in
+struct ProfileZone
+{
+    int zone;
+    int64_t start;
+
+    explicit ProfileZone(int id) : zone(id), start(profilerEnabled ? ProfilerNow() : -1)
+    {
+    }
+
+    ~ProfileZone()
+    {
+        if (start >= 0)
+            ProfilerRecord(zone, start, ProfilerNow());
+    }
+};
+
+#endif
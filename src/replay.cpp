@@ -0,0 +1,273 @@
+#include "replay.h"
+#include "savefile.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const uint16_t replayVersion = 2;
+static const size_t replayHeaderSize = 44;
+static const size_t replayHeaderSizeV1 = 40; // before the level set crc
+
+static int KeyCode(char key)
+{
+    switch (key)
+    {
+    case 'R':
+        return 0;
+    case 'L':
+        return 1;
+    case 'U':
+        return 2;
+    default:
+        return 3;
+    }
+}
+
+static void PutU32(std::string &out, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back((char)((v >> (i * 8)) & 0xFF));
+}
+
+static uint32_t GetU32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void PutVarint(std::string &out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back((char)((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+static bool GetVarint(const unsigned char *&p, const unsigned char *end, uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7)
+    {
+        unsigned char b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+void StartRecording(Replay &rec, GameState &game, uint64_t seed)
+{
+    rec.seed = seed;
+    rec.gridCountX = game.gridCountX;
+    rec.gridCountY = game.gridCountY;
+    rec.mode = game.currentMode;
+    rec.tickCount = 0;
+    rec.finalScore = -1;
+    rec.levelsCrc = StoryLevels(game).crc;
+    rec.inputs.clear();
+
+    SeedRandom(game, seed);
+    ResetGame(game, true);
+}
+
+// call once per Step with the same input Step got
+void RecordTick(Replay &rec, Input input)
+{
+    if (input.key != 0)
+        rec.inputs.push_back({rec.tickCount, input.key});
+    rec.tickCount++;
+}
+
+// drops every tick from tickCount on, for a game that was rewound
+void TruncateRecording(Replay &rec, uint32_t tickCount)
+{
+    if (tickCount >= rec.tickCount)
+        return;
+    while (!rec.inputs.empty() && rec.inputs.back().tick >= tickCount)
+        rec.inputs.pop_back();
+    rec.tickCount = tickCount;
+}
+
+// remembers how the game ended so playback can be checked against it
+void FinishRecording(Replay &rec, const GameState &game)
+{
+    rec.finalScore = game.score;
+}
+
+std::string EncodeReplay(const Replay &rec)
+{
+    std::string out;
+    out.reserve(replayHeaderSize + rec.inputs.size() * 2 + 4);
+    out.append("SNKR", 4);
+    out.push_back((char)(replayVersion & 0xFF));
+    out.push_back((char)(replayVersion >> 8));
+    out.push_back(0);
+    out.push_back(0);
+    PutU32(out, (uint32_t)rec.seed);
+    PutU32(out, (uint32_t)(rec.seed >> 32));
+    PutU32(out, rec.gridCountX);
+    PutU32(out, rec.gridCountY);
+    PutU32(out, rec.mode);
+    PutU32(out, rec.tickCount);
+    PutU32(out, (uint32_t)rec.finalScore);
+    PutU32(out, (uint32_t)rec.inputs.size());
+    PutU32(out, rec.levelsCrc);
+
+    uint32_t lastTick = 0;
+    for (const ReplayInput &in : rec.inputs)
+    {
+        PutVarint(out, ((uint64_t)(in.tick - lastTick) << 2) | KeyCode(in.key));
+        lastTick = in.tick;
+    }
+
+    PutU32(out, Crc32((const unsigned char *)out.data(), out.size()));
+    return out;
+}
+
+bool DecodeReplay(const unsigned char *data, size_t size, Replay &rec)
+{
+    if (size < replayHeaderSizeV1 + 4 || memcmp(data, "SNKR", 4) != 0)
+        return false;
+    uint32_t version = data[4] | (data[5] << 8);
+    size_t headerSize = version == 1 ? replayHeaderSizeV1 : replayHeaderSize;
+    if (version < 1 || version > replayVersion || size < headerSize + 4)
+        return false;
+    if (Crc32(data, size - 4) != GetU32(data + size - 4))
+        return false;
+
+    Replay out;
+    out.seed = (uint64_t)GetU32(data + 8) | ((uint64_t)GetU32(data + 12) << 32);
+    out.gridCountX = (int)GetU32(data + 16);
+    out.gridCountY = (int)GetU32(data + 20);
+    uint32_t mode = GetU32(data + 24);
+    out.tickCount = GetU32(data + 28);
+    out.finalScore = (int)GetU32(data + 32);
+    uint32_t inputCount = GetU32(data + 36);
+    out.levelsCrc = version >= 2 ? GetU32(data + 40) : 0;
+    if (mode > MAZE || out.gridCountX < 10 || out.gridCountY < 10 || out.gridCountX > 65536 || out.gridCountY > 65536)
+        return false;
+    if (inputCount > out.tickCount)
+        return false;
+    out.mode = (GameMode)mode;
+
+    const char keys[] = {'R', 'L', 'U', 'D'};
+    const unsigned char *p = data + headerSize;
+    const unsigned char *end = data + size - 4;
+    out.inputs.reserve(inputCount);
+    uint64_t tick = 0;
+    for (uint32_t i = 0; i < inputCount; i++)
+    {
+        uint64_t v;
+        if (!GetVarint(p, end, v))
+            return false;
+        tick += v >> 2;
+        if (tick >= out.tickCount)
+            return false;
+        out.inputs.push_back({(uint32_t)tick, keys[v & 3]});
+    }
+    if (p != end)
+        return false;
+
+    rec = out;
+    return true;
+}
+
+bool ReadReplayFile(const char *path, Replay &rec)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+
+    std::string buffer;
+    bool ok = fseek(f, 0, SEEK_END) == 0;
+    long size = ok ? ftell(f) : -1;
+    if (size > 0 && fseek(f, 0, SEEK_SET) == 0)
+    {
+        buffer.resize((size_t)size);
+        ok = fread(&buffer[0], 1, buffer.size(), f) == buffer.size();
+    }
+    else
+    {
+        ok = false;
+    }
+    fclose(f);
+
+    return ok && DecodeReplay((const unsigned char *)buffer.data(), buffer.size(), rec);
+}
+
+bool ReplayMatchesLevels(const Replay &rec, const LevelSet &levels)
+{
+    return rec.mode != STORY || rec.levelsCrc == 0 || rec.levelsCrc == levels.crc;
+}
+
+static void AddKeyframe(ReplayPlayer &player)
+{
+    player.keyframes.push_back({player.tick, player.nextInput, EncodeSave(player.game)});
+}
+
+void StartPlayback(ReplayPlayer &player, const Replay &rec, uint32_t keyframeInterval)
+{
+    player.replay = rec;
+    player.tick = 0;
+    player.nextInput = 0;
+    player.keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+    player.keyframes.clear();
+
+    player.game.currentMode = rec.mode;
+    player.game.gridCountX = rec.gridCountX;
+    player.game.gridCountY = rec.gridCountY;
+    SeedRandom(player.game, rec.seed);
+    ResetGame(player.game, true);
+    AddKeyframe(player);
+}
+
+bool PlaybackFinished(const ReplayPlayer &player)
+{
+    return player.tick >= player.replay.tickCount || player.game.gameOver;
+}
+
+// one recorded tick, keyframes are taken the first time a tick is reached
+int PlaybackStep(ReplayPlayer &player)
+{
+    if (PlaybackFinished(player))
+        return EVENT_NONE;
+
+    const std::vector<ReplayInput> &inputs = player.replay.inputs;
+    Input input;
+    if (player.nextInput < inputs.size() && inputs[player.nextInput].tick == player.tick)
+        input.key = inputs[player.nextInput++].key;
+
+    int events = Step(player.game, input);
+    player.tick++;
+
+    if (!player.game.gameOver && player.tick % player.keyframeInterval == 0 &&
+        player.tick / player.keyframeInterval == player.keyframes.size())
+        AddKeyframe(player);
+    return events;
+}
+
+// jumps to the closest keyframe at or before tick and simulates the rest
+void SeekPlayback(ReplayPlayer &player, uint32_t tick)
+{
+    if (tick > player.replay.tickCount)
+        tick = player.replay.tickCount;
+
+    size_t k = tick / player.keyframeInterval;
+    if (k >= player.keyframes.size())
+        k = player.keyframes.size() - 1;
+
+    // going forward from where we are is cheaper than reloading
+    if (!(tick >= player.tick && player.tick >= player.keyframes[k].tick))
+    {
+        const ReplayKeyframe &key = player.keyframes[k];
+        const std::string &state = key.state;
+        DecodeSave((const unsigned char *)state.data(), state.size(), player.game);
+        player.tick = key.tick;
+        player.nextInput = key.nextInput;
+    }
+
+    while (player.tick < tick && !player.game.gameOver)
+        PlaybackStep(player);
+}
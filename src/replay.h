@@ -0,0 +1,73 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "game.h"
+
+// a turn that happened on a given tick
+struct ReplayInput
+{
+    uint32_t tick;
+    char key;
+};
+
+// everything needed to play a game again: how it started plus every turn.
+// the simulation is deterministic, so the same seed and inputs give the same game
+struct Replay
+{
+    uint64_t seed = 0;
+    int gridCountX = 0;
+    int gridCountY = 0;
+    GameMode mode = NORMAL;
+    uint32_t tickCount = 0;
+    int finalScore = -1; // -1 while still recording
+    uint32_t levelsCrc = 0; // story levels it was recorded on, 0 in version 1 files that don't say
+    std::vector<ReplayInput> inputs;
+};
+
+// snapshot of the game at a tick, stored in the compact save format
+struct ReplayKeyframe
+{
+    uint32_t tick;
+    size_t nextInput;
+    std::string state;
+};
+
+// plays a replay back and keeps a keyframe every keyframeInterval ticks,
+// so seeking only ever simulates less than one interval
+struct ReplayPlayer
+{
+    Replay replay;
+    GameState game;
+    uint32_t tick = 0;
+    size_t nextInput = 0;
+    uint32_t keyframeInterval = 256;
+    std::vector<ReplayKeyframe> keyframes;
+};
+
+// recording, StartRecording seeds and resets the game itself
+void StartRecording(Replay &rec, GameState &game, uint64_t seed);
+void RecordTick(Replay &rec, Input input);
+void TruncateRecording(Replay &rec, uint32_t tickCount);
+void FinishRecording(Replay &rec, const GameState &game);
+
+// file format: "SNKR", version, setup, tick count, final score, input count,
+// the story levels' LevelSetCrc (since version 2), inputs as varints of
+// (ticks since last input << 2 | direction), then a crc32 of all of it
+std::string EncodeReplay(const Replay &rec);
+bool DecodeReplay(const unsigned char *data, size_t size, Replay &rec);
+bool ReadReplayFile(const char *path, Replay &rec);
+
+// false for a story game recorded on other levels, it would play out differently
+bool ReplayMatchesLevels(const Replay &rec, const LevelSet &levels);
+
+// playback
+void StartPlayback(ReplayPlayer &player, const Replay &rec, uint32_t keyframeInterval);
+int PlaybackStep(ReplayPlayer &player);
+bool PlaybackFinished(const ReplayPlayer &player);
+void SeekPlayback(ReplayPlayer &player, uint32_t tick);
+
+#endif
@@ -0,0 +1,175 @@
+#include "rewind.h"
+#include "savefile.h"
+
+#include <cmath>
+
+static uint8_t DirCode(char key)
+{
+    switch (key)
+    {
+    case 'R':
+        return 0;
+    case 'L':
+        return 1;
+    case 'U':
+        return 2;
+    default:
+        return 3;
+    }
+}
+
+static void AddKeyframe(RewindHistory &history, const GameState &game)
+{
+    history.keyframes.push_back({history.newest, EncodeSave(game)});
+}
+
+void ResetRewind(RewindHistory &history, const GameState &game)
+{
+    float fastest = game.minInterval > 0.0f ? game.minInterval : 0.05f;
+    history.capacity = (uint32_t)ceilf(history.seconds / fastest);
+    history.newest = 0;
+
+    // the oldest keyframe can be up to an interval behind the window
+    history.deltas.assign(history.capacity + history.keyframeInterval + 1, 0);
+    history.foods.clear();
+    history.keyframes.clear();
+    AddKeyframe(history, game);
+}
+
+void RecordRewind(RewindHistory &history, const GameState &game, int events)
+{
+    if (game.gameOver || !(events & EVENT_MOVED) || history.keyframes.empty())
+        return;
+
+    history.newest++;
+    uint8_t delta = DirCode(game.key);
+    if (events & EVENT_ATE_FOOD)
+    {
+        delta |= 4;
+        history.foods.push_back({history.newest, game.foodX, game.foodY, game.rngState});
+    }
+    history.deltas[history.newest % history.deltas.size()] = delta;
+
+    // a level up respawns the snake, which no delta can describe
+    if ((events & EVENT_LEVEL_UP) || history.newest % history.keyframeInterval == 0)
+        AddKeyframe(history, game);
+
+    // drop what fell out of the window, keeping one keyframe at or before its start
+    if (history.newest > history.capacity)
+    {
+        uint32_t start = history.newest - history.capacity;
+        while (history.keyframes.size() > 1 && history.keyframes[1].tick <= start)
+            history.keyframes.pop_front();
+    }
+    while (!history.foods.empty() && history.foods.front().tick <= history.keyframes.front().tick)
+        history.foods.pop_front();
+}
+
+uint32_t RewindOldest(const RewindHistory &history)
+{
+    return history.keyframes.empty() ? 0 : history.keyframes.front().tick;
+}
+
+uint32_t RewindNewest(const RewindHistory &history)
+{
+    return history.newest;
+}
+
+bool RestoreRewind(const RewindHistory &history, GameState &game, uint32_t tick)
+{
+    if (history.keyframes.empty())
+        return false;
+    if (tick < RewindOldest(history))
+        tick = RewindOldest(history);
+    if (tick > history.newest)
+        tick = history.newest;
+
+    size_t k = history.keyframes.size() - 1;
+    while (history.keyframes[k].tick > tick)
+        k--;
+    const RewindKeyframe &keyframe = history.keyframes[k];
+    if (!DecodeSave((const unsigned char *)keyframe.state.data(), keyframe.state.size(), game))
+        return false;
+
+    size_t food = 0;
+    while (food < history.foods.size() && history.foods[food].tick <= keyframe.tick)
+        food++;
+
+    // the same moves Step made, without the checks, the rng or the food search
+    bool hurdlesActive = HurdlesActive(game);
+    int w = game.gridCountX;
+    int h = game.gridCountY;
+    for (uint32_t t = keyframe.tick + 1; t <= tick; t++)
+    {
+        uint8_t delta = history.deltas[t % history.deltas.size()];
+        int x = game.snake.Head().x;
+        int y = game.snake.Head().y;
+        switch (delta & 3)
+        {
+        case 0:
+            x = (x + 1) % w;
+            game.key = 'R';
+            break;
+        case 1:
+            x = (x + w - 1) % w;
+            game.key = 'L';
+            break;
+        case 2:
+            y = (y + h - 1) % h;
+            game.key = 'U';
+            break;
+        case 3:
+            y = (y + 1) % h;
+            game.key = 'D';
+            break;
+        }
+
+        if (!(delta & 4))
+        {
+            const Cell &tail = game.snake.Tail();
+            game.snakeCells.Clear(tail.x, tail.y);
+            if (!(hurdlesActive && game.hurdleCells.Test(tail.x, tail.y)))
+                game.freeCells.Add(tail.y * w + tail.x);
+            game.snake.PopTail();
+        }
+        game.snake.PushHead(x, y);
+        game.snakeCells.Set(x, y);
+        game.freeCells.Remove(y * w + x);
+
+        if (delta & 4)
+        {
+            const RewindFood &f = history.foods[food++];
+            game.score += 10;
+            if (game.moveInterval > game.minInterval)
+                game.moveInterval -= game.intervalStep;
+            game.foodX = f.x;
+            game.foodY = f.y;
+            game.rngState = f.rngState;
+        }
+    }
+
+    game.moveTimer = 0.0f;
+    return true;
+}
+
+void TruncateRewind(RewindHistory &history, uint32_t tick)
+{
+    if (tick >= history.newest)
+        return;
+    if (tick < RewindOldest(history))
+        tick = RewindOldest(history);
+
+    history.newest = tick;
+    while (history.keyframes.size() > 1 && history.keyframes.back().tick > tick)
+        history.keyframes.pop_back();
+    while (!history.foods.empty() && history.foods.back().tick > tick)
+        history.foods.pop_back();
+}
+
+size_t RewindMemory(const RewindHistory &history)
+{
+    size_t bytes = history.deltas.size() + history.foods.size() * sizeof(RewindFood);
+    for (const RewindKeyframe &keyframe : history.keyframes)
+        bytes += sizeof(RewindKeyframe) + keyframe.state.size();
+    return bytes;
+}
@@ -0,0 +1,64 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include "game.h"
+
+// food that appeared on a tick, with the rng state after it was placed
+struct RewindFood
+{
+    uint32_t tick;
+    int32_t x;
+    int32_t y;
+    uint64_t rngState;
+};
+
+// the whole game at a tick, stored in the compact save format
+struct RewindKeyframe
+{
+    uint32_t tick;
+    std::string state;
+};
+
+// the last few hundred ticks of a game, so it can be scrubbed back. every
+// tick is one byte (which way the head moved, whether the snake grew) plus a
+// food entry when it ate, and every keyframeInterval ticks the game is saved
+// whole. restoring a tick loads the keyframe before it and plays the deltas
+// forward, at most keyframeInterval of them
+struct RewindHistory
+{
+    float seconds = 30.0f;   // how far back, at the fastest speed
+    uint32_t capacity = 0;   // ticks kept, worked out from seconds on reset
+    uint32_t keyframeInterval = 64;
+
+    uint32_t newest = 0;
+    std::vector<uint8_t> deltas; // ring indexed by tick, bits 0-1 direction, bit 2 grew
+    std::deque<RewindFood> foods;
+    std::deque<RewindKeyframe> keyframes;
+};
+
+// starts over from the game as it is now, call after anything moves the
+// snake outside of Step
+void ResetRewind(RewindHistory &history, const GameState &game);
+
+// call after every Step with what it returned, the tick that ends the game
+// isn't kept so rewinding always lands on a live snake
+void RecordRewind(RewindHistory &history, const GameState &game, int events);
+
+uint32_t RewindOldest(const RewindHistory &history);
+uint32_t RewindNewest(const RewindHistory &history);
+
+// puts the game back to how it was after the given tick, clamped to what is kept
+bool RestoreRewind(const RewindHistory &history, GameState &game, uint32_t tick);
+
+// forgets everything after tick, for when play goes on from there
+void TruncateRewind(RewindHistory &history, uint32_t tick);
+
+// bytes held right now, keyframes included
+size_t RewindMemory(const RewindHistory &history);
+
+#endif
@@ -0,0 +1,313 @@
+#include "savefile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+static const size_t headerSize = 16;
+static const size_t fixedPayloadSize = 64;
+static const size_t fixedPayloadSizeV2 = 60; // before the level set crc
+static const size_t fixedPayloadSizeV1 = 48; // before maze mode
+
+struct CrcTable
+{
+    uint32_t entries[256];
+};
+
+static CrcTable BuildCrcTable()
+{
+    CrcTable table;
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table.entries[i] = c;
+    }
+    return table;
+}
+
+// saves, replays, the level cache and the leaderboard all check crcs, from
+// any thread. the static makes the first of them build the table once
+uint32_t Crc32(const unsigned char *data, size_t size)
+{
+    static const CrcTable table = BuildCrcTable();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++)
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void PutU8(std::string &out, uint32_t v)
+{
+    out.push_back((char)(v & 0xFF));
+}
+
+static void PutU16(std::string &out, uint32_t v)
+{
+    PutU8(out, v);
+    PutU8(out, v >> 8);
+}
+
+static void PutU32(std::string &out, uint32_t v)
+{
+    PutU16(out, v);
+    PutU16(out, v >> 16);
+}
+
+static void PutU64(std::string &out, uint64_t v)
+{
+    PutU32(out, (uint32_t)v);
+    PutU32(out, (uint32_t)(v >> 32));
+}
+
+static uint32_t GetU16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t GetU32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t GetU64(const unsigned char *p)
+{
+    return (uint64_t)GetU32(p) | ((uint64_t)GetU32(p + 4) << 32);
+}
+
+// direction code for the step from a to b, treating the board as wrapping
+static int StepCode(const Cell &a, const Cell &b, int gridX, int gridY)
+{
+    int dx = b.x - a.x;
+    int dy = b.y - a.y;
+    if (dx == gridX - 1)
+        dx = -1;
+    else if (dx == -(gridX - 1))
+        dx = 1;
+    if (dy == gridY - 1)
+        dy = -1;
+    else if (dy == -(gridY - 1))
+        dy = 1;
+
+    if (dx == 1 && dy == 0)
+        return 0;
+    if (dx == -1 && dy == 0)
+        return 1;
+    if (dx == 0 && dy == -1)
+        return 2;
+    if (dx == 0 && dy == 1)
+        return 3;
+    return -1;
+}
+
+std::string EncodeSave(const GameState &game)
+{
+    const SnakeBody &snake = game.snake;
+    int length = snake.Length();
+
+    std::string payload;
+    payload.reserve(fixedPayloadSize + length / 4 + 1);
+    PutU32(payload, game.gridCountX);
+    PutU32(payload, game.gridCountY);
+    PutU8(payload, game.currentMode);
+    PutU8(payload, game.storyLevel);
+    PutU8(payload, (unsigned char)game.key);
+    PutU8(payload, game.storyLevel >> 8); // was reserved, zero in older saves
+    PutU32(payload, (uint32_t)game.score);
+    PutU32(payload, (uint32_t)game.foodX);
+    PutU32(payload, (uint32_t)game.foodY);
+    uint32_t intervalBits;
+    memcpy(&intervalBits, &game.moveInterval, sizeof(intervalBits));
+    PutU32(payload, intervalBits);
+    PutU64(payload, game.rngState);
+    PutU32(payload, length);
+    PutU32(payload, snake.Head().x);
+    PutU32(payload, snake.Head().y);
+    PutU64(payload, game.mazeSeed);
+    uint32_t densityBits;
+    memcpy(&densityBits, &game.mazeDensity, sizeof(densityBits));
+    PutU32(payload, densityBits);
+    PutU32(payload, StoryLevels(game).crc);
+
+    // body as 2 bit steps, four to a byte
+    unsigned char packed = 0;
+    for (int i = 1; i < length; i++)
+    {
+        int code = StepCode(snake.At(i - 1), snake.At(i), game.gridCountX, game.gridCountY);
+        if (code < 0)
+            return std::string(); // body isn't connected, nothing sensible to save
+        packed |= code << (((i - 1) & 3) * 2);
+        if (((i - 1) & 3) == 3 || i == length - 1)
+        {
+            payload.push_back((char)packed);
+            packed = 0;
+        }
+    }
+
+    std::string out;
+    out.reserve(headerSize + payload.size());
+    out.append("SNKS", 4);
+    PutU16(out, saveVersion);
+    PutU16(out, headerSize);
+    PutU32(out, (uint32_t)payload.size());
+    PutU32(out, Crc32((const unsigned char *)payload.data(), payload.size()));
+    out += payload;
+    return out;
+}
+
+bool DecodeSave(const unsigned char *data, size_t size, GameState &game)
+{
+    // header
+    if (size < headerSize || memcmp(data, "SNKS", 4) != 0)
+        return false;
+    uint32_t version = GetU16(data + 4);
+    if (version < 1 || version > saveVersion || GetU16(data + 6) != headerSize)
+        return false;
+    size_t fixedSize = version == 1 ? fixedPayloadSizeV1 : (version == 2 ? fixedPayloadSizeV2 : fixedPayloadSize);
+    uint32_t payloadSize = GetU32(data + 8);
+    if (payloadSize != size - headerSize || payloadSize < fixedSize)
+        return false;
+    const unsigned char *p = data + headerSize;
+    if (Crc32(p, payloadSize) != GetU32(data + 12))
+        return false;
+
+    // fixed fields
+    int gridX = (int)GetU32(p);
+    int gridY = (int)GetU32(p + 4);
+    int mode = p[8];
+    int storyLevel = p[9] | (p[11] << 8);
+    char key = (char)p[10];
+    int score = (int)GetU32(p + 12);
+    int foodX = (int)GetU32(p + 16);
+    int foodY = (int)GetU32(p + 20);
+    uint32_t intervalBits = GetU32(p + 24);
+    float moveInterval;
+    memcpy(&moveInterval, &intervalBits, sizeof(moveInterval));
+    uint64_t rngState = GetU64(p + 28);
+    uint32_t length = GetU32(p + 36);
+    int headX = (int)GetU32(p + 40);
+    int headY = (int)GetU32(p + 44);
+    uint64_t mazeSeed = 0;
+    float mazeDensity = game.mazeDensity;
+    if (version >= 2)
+    {
+        mazeSeed = GetU64(p + 48);
+        uint32_t densityBits = GetU32(p + 56);
+        memcpy(&mazeDensity, &densityBits, sizeof(mazeDensity));
+    }
+    const LevelSet &levels = StoryLevels(game);
+    uint32_t levelsCrc = version >= 3 ? GetU32(p + 60) : levels.crc;
+
+    // nothing in here is trusted until it has been range checked
+    if (gridX != game.gridCountX || gridY != game.gridCountY)
+        return false;
+    if (mode < EASY || mode > MAZE || (version == 1 && mode == MAZE) || storyLevel < 1 || storyLevel > (int)levels.levels.size())
+        return false;
+    if (mode == STORY && levelsCrc != levels.crc)
+        return false;
+    if (key != 'R' && key != 'L' && key != 'U' && key != 'D')
+        return false;
+    if (!(foodX == -1 && foodY == -1) && (foodX < 0 || foodX >= gridX || foodY < 0 || foodY >= gridY))
+        return false;
+    if (!(moveInterval > 0.0f && moveInterval <= 1.0f) || !(mazeDensity >= 0.0f && mazeDensity <= 1.0f))
+        return false;
+    if (length < 1 || (uint64_t)length > (uint64_t)gridX * gridY)
+        return false;
+    if (payloadSize != fixedSize + (length - 1 + 3) / 4)
+        return false;
+    if (headX < 0 || headX >= gridX || headY < 0 || headY >= gridY)
+        return false;
+
+    // body
+    SnakeBody body;
+    body.Reserve(length);
+    body.PushTail(headX, headY);
+    const unsigned char *steps = p + fixedSize;
+    int x = headX, y = headY;
+    for (uint32_t i = 1; i < length; i++)
+    {
+        int code = (steps[(i - 1) >> 2] >> (((i - 1) & 3) * 2)) & 3;
+        switch (code)
+        {
+        case 0:
+            x = (x + 1) % gridX;
+            break;
+        case 1:
+            x = (x + gridX - 1) % gridX;
+            break;
+        case 2:
+            y = (y + gridY - 1) % gridY;
+            break;
+        case 3:
+            y = (y + 1) % gridY;
+            break;
+        }
+        body.PushTail(x, y);
+    }
+
+    game.currentMode = (GameMode)mode;
+    game.storyLevel = storyLevel;
+    game.key = key;
+    game.score = score;
+    game.foodX = foodX;
+    game.foodY = foodY;
+    game.moveInterval = moveInterval;
+    game.rngState = rngState;
+    game.mazeSeed = mazeSeed;
+    game.mazeDensity = mazeDensity;
+    game.snake = std::move(body);
+    game.gameOver = false;
+    game.gameWon = false;
+    game.deathCause = DEATH_NONE;
+    EnterLevel(game);
+    RebuildOccupancy(game);
+    return true;
+}
+
+// a save that would load but for being a story game on other levels
+static bool OtherLevels(const unsigned char *data, size_t size, const GameState &game)
+{
+    if (size < headerSize + fixedPayloadSize || memcmp(data, "SNKS", 4) != 0 || GetU16(data + 4) < 3)
+        return false;
+    const unsigned char *p = data + headerSize;
+    if (Crc32(p, size - headerSize) != GetU32(data + 12))
+        return false;
+    return p[8] == STORY && GetU32(p + 60) != StoryLevels(game).crc;
+}
+
+bool ReadSaveFile(const char *path, GameState &game, std::string &error)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        error = "can't be opened";
+        return false;
+    }
+
+    std::vector<unsigned char> buffer;
+    bool ok = fseek(f, 0, SEEK_END) == 0;
+    long size = ok ? ftell(f) : -1;
+    if (size > 0 && fseek(f, 0, SEEK_SET) == 0)
+    {
+        buffer.resize((size_t)size);
+        ok = fread(buffer.data(), 1, buffer.size(), f) == buffer.size();
+    }
+    else
+    {
+        ok = false;
+    }
+    fclose(f);
+
+    if (!ok)
+        error = "can't be read";
+    else if (DecodeSave(buffer.data(), buffer.size(), game))
+        return true;
+    else if (OtherLevels(buffer.data(), buffer.size(), game))
+        error = "was saved on other story levels";
+    else
+        error = "is damaged, from another version or for another board size";
+    return false;
+}
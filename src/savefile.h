@@ -0,0 +1,44 @@
+#ifndef SAVEFILE_H
+#define SAVEFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "game.h"
+
+// binary save layout, all integers little endian
+//
+//   header (16 bytes)
+//     char[4] magic "SNKS"
+//     u16     version
+//     u16     header size
+//     u32     payload size
+//     u32     crc32 of the payload
+//   payload
+//     u32 gridX, u32 gridY
+//     u8 mode, u8 storyLevel low byte, u8 key, u8 storyLevel high byte
+//     i32 score, i32 foodX, i32 foodY
+//     f32 moveInterval
+//     u64 rng state
+//     u32 length, u32 headX, u32 headY
+//     u64 maze seed, f32 maze density (since version 2)
+//     u32 crc of the story levels played (since version 3, see LevelSetCrc)
+//     body: length - 1 steps, 2 bits each (0 R, 1 L, 2 U, 3 D), four per byte,
+//           each one the direction from a segment to the next one toward the tail
+
+const char saveFilePath[] = "savefile.dat";
+const uint16_t saveVersion = 3; // older saves, without the newer fields, still load
+
+uint32_t Crc32(const unsigned char *data, size_t size);
+std::string EncodeSave(const GameState &game);
+
+// fills game only if the whole buffer checks out, false for anything
+// truncated, corrupt, from another version, for a different board size or
+// a story game on other story levels
+bool DecodeSave(const unsigned char *data, size_t size, GameState &game);
+
+// reads the file with a single read and decodes it, false with a message
+// saying why it couldn't be used
+bool ReadSaveFile(const char *path, GameState &game, std::string &error);
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef SNAKEBODY_H
+#define SNAKEBODY_H
+
+#include <cstddef>
+#include <vector>
+
+struct Cell
+{
+    int x;
+    int y;
+};
+
+// snake segments kept head first in a ring buffer, moving and growing
+// only touch the ends so nothing is shifted per tick
+struct SnakeBody
+{
+    std::vector<Cell> cells; // capacity is always a power of two
+    size_t head = 0;         // slot holding segment 0
+    size_t count = 0;
+
+    int Length() const
+    {
+        return (int)count;
+    }
+
+    // i = 0 is the head, Length() - 1 is the tail
+    const Cell &At(int i) const
+    {
+        return cells[(head + i) & (cells.size() - 1)];
+    }
+
+    Cell &At(int i)
+    {
+        return cells[(head + i) & (cells.size() - 1)];
+    }
+
+    const Cell &Head() const
+    {
+        return At(0);
+    }
+
+    const Cell &Tail() const
+    {
+        return At((int)count - 1);
+    }
+
+    void Clear()
+    {
+        head = 0;
+        count = 0;
+    }
+
+    void PushHead(int x, int y)
+    {
+        if (count == cells.size())
+            Grow();
+        head = (head - 1) & (cells.size() - 1);
+        cells[head] = {x, y};
+        count++;
+    }
+
+    // appends behind the tail, used when building a body in order
+    void PushTail(int x, int y)
+    {
+        if (count == cells.size())
+            Grow();
+        cells[(head + count) & (cells.size() - 1)] = {x, y};
+        count++;
+    }
+
+    void PopTail()
+    {
+        if (count > 0)
+            count--;
+    }
+
+    // makes room for n segments up front so building a long body never regrows
+    void Reserve(size_t n)
+    {
+        while (cells.size() < n)
+            Grow();
+    }
+
+    // doubles the storage and unrolls the ring so the head sits at slot 0
+    void Grow()
+    {
+        size_t newSize = cells.empty() ? 16 : cells.size() * 2;
+        std::vector<Cell> bigger(newSize);
+        for (size_t i = 0; i < count; i++)
+            bigger[i] = cells[(head + i) & (cells.size() - 1)];
+        cells.swap(bigger);
+        head = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "telemetry.h"
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+
+static const uint16_t telemetryVersion = 1;
+static const size_t logHeaderSize = 16;
+static const size_t recordSize = 18;
+static const int drainMs = 20; // how often the writer empties the ring
+
+static TelemetryRing ring;
+static std::thread writer;
+static std::atomic<bool> running{false};
+static bool active = false; // game thread's copy, pushes are dropped while false
+static FILE *logFile = nullptr;
+static std::chrono::steady_clock::time_point sessionStart;
+
+static void PutU8(std::string &out, uint32_t v)
+{
+    out.push_back((char)(v & 0xFF));
+}
+
+static void PutU16(std::string &out, uint32_t v)
+{
+    PutU8(out, v);
+    PutU8(out, v >> 8);
+}
+
+static void PutU32(std::string &out, uint32_t v)
+{
+    PutU16(out, v);
+    PutU16(out, v >> 16);
+}
+
+static void PutU64(std::string &out, uint64_t v)
+{
+    PutU32(out, (uint32_t)v);
+    PutU32(out, (uint32_t)(v >> 32));
+}
+
+static uint32_t GetU16(const unsigned char *p)
+{
+    return p[0] | (uint32_t)p[1] << 8;
+}
+
+static uint32_t GetU32(const unsigned char *p)
+{
+    return GetU16(p) | GetU16(p + 2) << 16;
+}
+
+static uint64_t GetU64(const unsigned char *p)
+{
+    return GetU32(p) | (uint64_t)GetU32(p + 4) << 32;
+}
+
+static void PutRecord(std::string &out, const TelemetryEvent &event)
+{
+    PutU8(out, event.type);
+    PutU8(out, event.detail);
+    PutU32(out, event.tick);
+    PutU64(out, (uint64_t)event.time);
+    PutU32(out, (uint32_t)event.value);
+}
+
+static int64_t SessionNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sessionStart).count();
+}
+
+// writes everything in the ring, with a record for anything dropped since
+// the last pass. one fwrite per pass, flushed so a crash loses one pass at most
+static void Drain(std::string &buffer, uint32_t &droppedSeen)
+{
+    static TelemetryEvent batch[telemetryCapacity];
+    buffer.clear();
+    uint32_t n = ring.Pop(batch, telemetryCapacity);
+    for (uint32_t i = 0; i < n; i++)
+        PutRecord(buffer, batch[i]);
+
+    uint32_t dropped = ring.dropped.load(std::memory_order_relaxed);
+    if (dropped != droppedSeen)
+    {
+        TelemetryEvent lost = {TELEMETRY_DROPPED, 0, 0, SessionNanos(), (int32_t)(dropped - droppedSeen)};
+        PutRecord(buffer, lost);
+        droppedSeen = dropped;
+    }
+
+    if (!buffer.empty())
+    {
+        fwrite(buffer.data(), 1, buffer.size(), logFile);
+        fflush(logFile);
+    }
+}
+
+static void WriterLoop()
+{
+    std::string buffer;
+    buffer.reserve(telemetryCapacity * recordSize);
+    uint32_t droppedSeen = 0;
+    while (running.load(std::memory_order_acquire))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(drainMs));
+        Drain(buffer, droppedSeen);
+    }
+    Drain(buffer, droppedSeen);
+}
+
+bool StartTelemetry(const char *path)
+{
+    if (active)
+        return true;
+    logFile = fopen(path, "wb");
+    if (!logFile)
+        return false;
+
+    std::string header("SNKT", 4);
+    PutU16(header, telemetryVersion);
+    PutU16(header, (uint32_t)recordSize);
+    PutU64(header, (uint64_t)(int64_t)time(nullptr));
+    fwrite(header.data(), 1, header.size(), logFile);
+
+    sessionStart = std::chrono::steady_clock::now();
+    active = true;
+    running.store(true, std::memory_order_release);
+    writer = std::thread(WriterLoop);
+    return true;
+}
+
+void StopTelemetry()
+{
+    if (!active)
+        return;
+    active = false;
+    running.store(false, std::memory_order_release);
+    writer.join();
+    fclose(logFile);
+    logFile = nullptr;
+}
+
+void PushTelemetry(TelemetryType type, uint8_t detail, uint32_t tick, int32_t value)
+{
+    if (!active)
+        return;
+    TelemetryEvent event = {type, detail, tick, SessionNanos(), value};
+    ring.Push(event);
+}
+
+const char *TelemetryTypeName(int type)
+{
+    static const char *names[TELEMETRY_TYPES] = {"tick", "game", "food", "death", "won", "level", "save", "dropped"};
+    if (type < 0 || type >= TELEMETRY_TYPES)
+        return "unknown";
+    return names[type];
+}
+
+bool DecodeTelemetryLog(const std::string &data, int64_t &startTime, std::vector<TelemetryEvent> &events)
+{
+    const unsigned char *p = (const unsigned char *)data.data();
+    if (data.size() < logHeaderSize || data.compare(0, 4, "SNKT") != 0)
+        return false;
+    if (GetU16(p + 4) != telemetryVersion || GetU16(p + 6) != recordSize)
+        return false;
+    startTime = (int64_t)GetU64(p + 8);
+
+    size_t count = (data.size() - logHeaderSize) / recordSize;
+    events.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const unsigned char *r = p + logHeaderSize + i * recordSize;
+        TelemetryEvent &event = events[i];
+        event.type = (TelemetryType)r[0];
+        event.detail = r[1];
+        event.tick = GetU32(r + 2);
+        event.time = (int64_t)GetU64(r + 6);
+        event.value = (int32_t)GetU32(r + 14);
+    }
+    return true;
+}
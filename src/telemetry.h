@@ -0,0 +1,101 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// gameplay events for looking at long sessions afterwards. the game thread
+// pushes them into a lock free ring and a worker thread writes them out, so
+// pushing never waits: when the ring is full the event is dropped and
+// counted, and the count goes into the log as an event of its own
+//
+// log layout, all integers little endian
+//
+//   header (16 bytes)
+//     char[4] magic "SNKT"
+//     u16     version
+//     u16     record size
+//     i64     unix time the session started
+//   records (18 bytes each)
+//     u8 type, u8 detail, u32 tick, i64 ns since the session started,
+//     i32 value
+//
+// a record cut short by a crash is ignored by the reader
+enum TelemetryType : uint8_t
+{
+    TELEMETRY_TICK = 0, // value: ns the tick took
+    TELEMETRY_GAME,     // a game started, detail: mode, value: 1 when continued from a save
+    TELEMETRY_FOOD,     // value: score after eating
+    TELEMETRY_DEATH,    // detail: DeathCause, value: final score
+    TELEMETRY_WON,      // value: final score
+    TELEMETRY_LEVEL,    // value: story level reached
+    TELEMETRY_SAVE,     // value: bytes in the save
+    TELEMETRY_DROPPED,  // value: events lost to a full ring since the last one
+    TELEMETRY_TYPES
+};
+
+struct TelemetryEvent
+{
+    TelemetryType type;
+    uint8_t detail;
+    uint32_t tick;
+    int64_t time; // ns since the session started
+    int32_t value;
+};
+
+const char telemetryPath[] = "telemetry.log";
+const uint32_t telemetryCapacity = 8192; // events, a power of two
+
+// single producer, single consumer. each index is only written by one side,
+// and on its own cache line so the two threads don't fight over it
+struct TelemetryRing
+{
+    alignas(64) std::atomic<uint32_t> head{0}; // next slot to read, consumer's
+    alignas(64) std::atomic<uint32_t> tail{0}; // next slot to write, producer's
+    std::atomic<uint32_t> dropped{0};           // pushes that found it full
+    TelemetryEvent slots[telemetryCapacity];
+
+    // producer side, false when the ring was full
+    bool Push(const TelemetryEvent &event)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == telemetryCapacity)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slots[t & (telemetryCapacity - 1)] = event;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, moves up to max events into out and returns how many
+    uint32_t Pop(TelemetryEvent *out, uint32_t max)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t n = tail.load(std::memory_order_acquire) - h;
+        if (n > max)
+            n = max;
+        for (uint32_t i = 0; i < n; i++)
+            out[i] = slots[(h + i) & (telemetryCapacity - 1)];
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+};
+
+// starts the writer thread on a fresh log at path. false when the file
+// couldn't be created, pushes are then ignored
+bool StartTelemetry(const char *path);
+void StopTelemetry(); // writes what is still in the ring, then joins the writer
+
+// game thread only. stamps the time and never blocks
+void PushTelemetry(TelemetryType type, uint8_t detail, uint32_t tick, int32_t value);
+
+const char *TelemetryTypeName(int type);
+
+// every whole record in a log, false when it isn't one
+bool DecodeTelemetryLog(const std::string &data, int64_t &startTime, std::vector<TelemetryEvent> &events);
+
+#endif
@@ -0,0 +1,331 @@
+// microbenchmarks for the simulation core, links without raylib. prints one
+// csv row per case so runs from two revisions can be diffed directly
+//
+// usage: snake_bench [--quick]
+//
+// columns: bench, board, snake length (snake count for the arena, density in
+// percent for maze generation, runs in the log for the leaderboard), ops timed,
+// ns/op, ops/s (ticks/s for step, autopilot and arena), heap allocations per op
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <new>
+#include <vector>
+#include "game.h"
+#include "autopilot.h"
+#include "arena.h"
+#include "leaderboard.h"
+#include "persist.h"
+
+// every operator new in the process goes through here
+static long long allocCount = 0;
+
+void *operator new(size_t size)
+{
+    allocCount++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+struct BenchResult
+{
+    long long ops;
+    double seconds;
+    long long allocs;
+};
+
+static double minSeconds = 0.2;
+static volatile long long sink = 0; // keeps results alive so loops aren't optimized out
+
+// runs op in batches until at least minSeconds have passed
+template <typename Op>
+static BenchResult Measure(Op op, long long batch = 4096)
+{
+    BenchResult r = {0, 0.0, 0};
+    long long allocsBefore = allocCount;
+    auto start = std::chrono::steady_clock::now();
+    do
+    {
+        for (long long i = 0; i < batch; i++)
+            op(i);
+        r.ops += batch;
+        r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (r.seconds < minSeconds);
+    r.allocs = allocCount - allocsBefore;
+    return r;
+}
+
+static void Report(const char *name, int w, int h, int length, const BenchResult &r)
+{
+    printf("%s,%dx%d,%d,%lld,%.2f,%.0f,%.4f\n", name, w, h, length, r.ops, r.seconds * 1e9 / r.ops,
+           r.ops / r.seconds, (double)r.allocs / r.ops);
+    fflush(stdout);
+}
+
+static void Report(const char *name, const GameState &game, int length, const BenchResult &r)
+{
+    Report(name, game.gridCountX, game.gridCountY, length, r);
+}
+
+// direction along a hamiltonian cycle of the board (height must be even):
+// right along row 0, snake back and forth over columns 1.. , then up column 0
+static char CycleDir(int x, int y, int w, int h)
+{
+    if (x == 0)
+        return y == 0 ? 'R' : 'U';
+    if (y % 2 == 0)
+        return x < w - 1 ? 'R' : 'D';
+    if (x > 1)
+        return 'L';
+    return y == h - 1 ? 'L' : 'D';
+}
+
+static void Advance(int &x, int &y, char dir)
+{
+    switch (dir)
+    {
+    case 'R':
+        x++;
+        break;
+    case 'L':
+        x--;
+        break;
+    case 'U':
+        y--;
+        break;
+    case 'D':
+        y++;
+        break;
+    }
+}
+
+// lays a snake of the given length on the cycle with its tail at (0, 0),
+// so following the cycle never runs into itself
+static void LayOnCycle(GameState &game, int length)
+{
+    int w = game.gridCountX;
+    int h = game.gridCountY;
+    game.snake.Clear();
+    game.snake.Reserve(length);
+    int x = 0;
+    int y = 0;
+    for (int i = 0; i < length; i++)
+    {
+        game.snake.PushHead(x, y);
+        if (i < length - 1)
+            Advance(x, y, CycleDir(x, y, w, h));
+    }
+    game.key = CycleDir(x, y, w, h);
+    game.gameOver = false;
+    RebuildOccupancy(game);
+    SpawnFood(game);
+}
+
+static void RunBoard(int w, int h)
+{
+    const int lengths[] = {4, 64, 4096, 65536, 1048576};
+
+    GameState *game = new GameState();
+    game->currentMode = NORMAL;
+    game->gridCountX = w;
+    game->gridCountY = h;
+    SeedRandom(*game, 1);
+    ResetGame(*game, true);
+
+    // random probe cells, generated up front so the rng isn't timed
+    const int probeCount = 4096;
+    static int probeX[probeCount];
+    static int probeY[probeCount];
+    for (int i = 0; i < probeCount; i++)
+    {
+        probeX[i] = RandomValue(*game, 0, w - 1);
+        probeY[i] = RandomValue(*game, 0, h - 1);
+    }
+
+    for (int length : lengths)
+    {
+        if ((long long)length * 2 > (long long)w * h)
+            break;
+        LayOnCycle(*game, length);
+
+        BenchResult r = Measure([&](long long i) {
+            sink += IsTileBlocked(probeX[i & (probeCount - 1)], probeY[i & (probeCount - 1)], *game, false);
+        });
+        Report("is_tile_blocked", *game, length, r);
+
+        r = Measure([&](long long i) {
+            sink += game->snakeCells.Test(probeX[i & (probeCount - 1)], probeY[i & (probeCount - 1)]);
+        });
+        Report("self_collision", *game, length, r);
+
+        r = Measure([&](long long) {
+            SpawnFood(*game);
+            sink += game->foodX;
+        });
+        Report("spawn_food", *game, length, r);
+
+        // a full tick: move, collision checks, eating and respawning food.
+        // the snake grows as it eats, so start over once it doubled
+        r = Measure([&](long long) {
+            const Cell &head = game->snake.Head();
+            Input input;
+            input.key = CycleDir(head.x, head.y, w, h);
+            sink += Step(*game, input);
+            if (game->gameOver || game->snake.Length() >= length * 2)
+                LayOnCycle(*game, length);
+        });
+        Report("step", *game, length, r);
+
+        // autopilot decision plus the tick it drives, the first decision
+        // sizes its scratch arrays so it runs once before timing
+        const AutopilotMode modes[] = {AUTOPILOT_PATH, AUTOPILOT_CYCLE};
+        const char *names[] = {"autopilot_path", "autopilot_cycle"};
+        for (int m = 0; m < 2; m++)
+        {
+            Autopilot *ap = new Autopilot();
+            ap->mode = modes[m];
+            LayOnCycle(*game, length);
+            AutopilotDecide(*ap, *game);
+            r = Measure([&](long long) {
+                sink += Step(*game, AutopilotDecide(*ap, *game));
+                if (game->gameOver || game->snake.Length() >= length * 2)
+                    LayOnCycle(*game, length);
+            });
+            Report(names[m], *game, length, r);
+            delete ap;
+        }
+    }
+
+    // hurdles only exist in hard mode and later story levels
+    game->currentMode = HARD;
+    LayOnCycle(*game, 4);
+    BenchResult r = Measure([&](long long i) {
+        sink += game->hurdleCells.Test(probeX[i & (probeCount - 1)], probeY[i & (probeCount - 1)]);
+    });
+    Report("hurdle_collision", *game, 4, r);
+    r = Measure([&](long long i) {
+        sink += IsTileBlocked(probeX[i & (probeCount - 1)], probeY[i & (probeCount - 1)], *game, true);
+    });
+    Report("is_tile_blocked_hurdles", *game, 4, r);
+
+    delete game;
+}
+
+// whole arena ticks, the length column is the number of snakes. the board
+// plays for a while first so bodies, deaths and respawns are in steady state
+static void RunArena(int w, int h, int snakes)
+{
+    Arena arena;
+    InitArena(arena, w, h, snakes, snakes, 1);
+    for (int i = 0; i < 200; i++)
+        StepArena(arena);
+
+    long long heads = 0;
+    BenchResult r = Measure([&](long long) {
+        heads += StepArena(arena).moved;
+    }, 8);
+    Report("arena_tick", w, h, snakes, r);
+    sink += heads;
+}
+
+// a whole maze board, generated fresh from a new seed each time
+static void RunMaze(int w, int h, float density)
+{
+    LevelLayout layout;
+    BenchResult r = Measure([&](long long i) {
+        GenerateMaze(w, h, density, (uint64_t)i + 1, w / 2, h / 2, layout);
+        sink += layout.hurdles.size();
+    }, 1);
+    Report("maze_generate", w, h, (int)(density * 100.0f + 0.5f), r);
+}
+
+static LeaderboardEntry BenchRun(long long i)
+{
+    uint64_t h = (uint64_t)(i + 1) * 0x9E3779B97F4A7C15ull;
+    LeaderboardEntry entry;
+    entry.mode = (GameMode)(h % leaderboardModes);
+    entry.score = (int)((h >> 8) % 100000);
+    entry.length = entry.score / 10 + 4;
+    entry.durationMs = (uint32_t)((h >> 32) % 3600000);
+    entry.date = 1700000000 + i;
+    entry.replaySeed = h;
+    return entry;
+}
+
+// the menu loading a log of the given number of runs, sorting new runs in
+// memory, and appending them to the log under the lock
+static void RunLeaderboard(int runs)
+{
+    const char *path = "bench_leaderboard.log";
+    const char *lockPath = "bench_leaderboard.lock";
+    std::vector<LeaderboardEntry> entries;
+    for (int i = 0; i < runs; i++)
+        entries.push_back(BenchRun(i));
+    WriteFileAtomic(path, EncodeLeaderboardLog(entries, 1));
+
+    BenchResult r = Measure([&](long long) {
+        Leaderboard board;
+        LoadLeaderboard(board, path, lockPath);
+        sink += LeaderboardBest(board, NORMAL);
+    }, 1);
+    Report("leaderboard_load", 0, 0, runs, r);
+
+    Leaderboard board;
+    LoadLeaderboard(board, path, lockPath);
+    r = Measure([&](long long i) {
+        sink += InsertLeaderboardEntry(board, BenchRun(runs + i));
+    });
+    Report("leaderboard_insert", 0, 0, runs, r);
+
+    // one record per run with an fsync each, compactions included
+    LoadLeaderboard(board, path, lockPath);
+    r = Measure([&](long long i) {
+        sink += AddLeaderboardEntry(board, BenchRun(runs + i), std::string());
+    }, 16);
+    Report("leaderboard_append", 0, 0, runs, r);
+
+    remove(path);
+    remove(lockPath);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--quick") == 0)
+        minSeconds = 0.02;
+
+    // 45x24 is what a 1920x1080 screen gives the game today
+    const int boards[][2] = {{45, 24}, {256, 256}, {1024, 1024}, {4096, 4096}};
+
+    printf("bench,board,length,ops,ns_per_op,ops_per_s,allocs_per_op\n");
+    for (const auto &board : boards)
+        RunBoard(board[0], board[1]);
+
+    const int mazes[][2] = {{45, 24}, {256, 256}, {2048, 2048}, {4096, 4096}};
+    for (const auto &maze : mazes)
+    {
+        RunMaze(maze[0], maze[1], 0.3f);
+        RunMaze(maze[0], maze[1], 0.7f);
+    }
+
+    RunArena(256, 256, 256);
+    RunArena(1024, 1024, 2048);
+    RunArena(1024, 1024, 16384);
+
+    RunLeaderboard(1000);
+    RunLeaderboard(100000);
+    return 0;
+}
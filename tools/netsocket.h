@@ -0,0 +1,131 @@
+#ifndef NETSOCKET_H
+#define NETSOCKET_H
+
+// small non-blocking tcp helpers for the arena server and the bot fleet.
+// posix sockets, the game itself never opens a socket
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// macos has no MSG_NOSIGNAL, the tools ignore SIGPIPE instead
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static inline uint64_t NowNs()
+{
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// no nagle, every tick goes out as soon as it is written
+static inline void PrepareSocket(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+static inline int ListenTcp(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+// blocking connect, the socket is non-blocking afterwards
+static inline int ConnectTcp(const char *host, int port)
+{
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = nullptr;
+    char portText[16];
+    snprintf(portText, sizeof(portText), "%d", port);
+    if (getaddrinfo(host, portText, &hints, &found) != 0)
+        return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, found->ai_addr, found->ai_addrlen) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+    if (fd >= 0)
+        PrepareSocket(fd);
+    return fd;
+}
+
+// writes as much of out as the socket takes and drops it from out,
+// false once the connection is gone
+static inline bool FlushSocket(int fd, std::string &out)
+{
+    size_t sent = 0;
+    while (sent < out.size())
+    {
+        ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            sent += (size_t)n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n < 0 && errno == EINTR)
+            continue;
+        return false;
+    }
+    out.erase(0, sent);
+    return true;
+}
+
+// appends whatever has arrived to in, false once the peer closed or failed
+static inline bool ReadSocket(int fd, std::string &in, uint64_t &received)
+{
+    char chunk[65536];
+    while (true)
+    {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n > 0)
+        {
+            in.append(chunk, (size_t)n);
+            received += (uint64_t)n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (n < 0 && errno == EINTR)
+            continue;
+        return false;
+    }
+}
+
+#endif
@@ -0,0 +1,297 @@
+// headless bot clients for snake_server. every client keeps its own copy of
+// the board from the server's deltas, steers its snake off that copy and
+// checks the copy against the server's checksum each tick
+//
+// usage: snake_fleet [options]
+//   --host H         server address (default 127.0.0.1)
+//   --port P         server port (default 7777)
+//   --clients N      connections (default 50)
+//   --seconds N      how long to play (default 10)
+//
+// prints per client bandwidth, tick jitter, turn latency (turn sent to the
+// first tick that used it) and desyncs. jitter is how much the gap between two
+// ticks arriving differs from the gap between the server sending them, each
+// gap measured on its own host's clock, so it holds across a lan as well
+
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <vector>
+#include <poll.h>
+#include "arena.h"
+#include "netproto.h"
+#include "netsocket.h"
+
+struct BotClient
+{
+    int fd = -1;
+    bool welcomed = false;
+    bool synced = false; // has the snapshot
+    bool failed = false;
+    int snake = -1;
+    int tickRate = 0;
+    Arena mirror;
+    std::string in;
+    std::string out;
+
+    uint32_t lastTick = 0;
+    uint64_t lastSentAt = 0;     // server clock
+    uint64_t lastReceivedAt = 0; // ours
+    uint32_t nextTurn = 1;
+    std::vector<uint64_t> turnSentAt; // by turn number
+    uint32_t ackedTurn = 0;
+    uint64_t rng = 0;
+
+    uint64_t received = 0;
+    uint64_t sent = 0;
+    uint64_t ticks = 0;
+    uint64_t missedTicks = 0;
+    uint64_t desyncs = 0;
+};
+
+struct Settings
+{
+    const char *host = "127.0.0.1";
+    int port = 7777;
+    int clients = 50;
+    double seconds = 10.0;
+};
+
+static Settings settings;
+static std::vector<double> tickJitterMs;
+static std::vector<double> turnLatencyMs;
+
+static uint64_t NextRandom(uint64_t &state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// eats what is next to it, keeps going straight while that is open and
+// now and then turns anyway so the server has turns to apply
+static void Steer(BotClient &c)
+{
+    if (c.snake >= (int)c.mirror.snakes.size() || !c.mirror.snakes[c.snake].alive)
+        return;
+    const ArenaSnake &me = c.mirror.snakes[c.snake];
+    const Cell &head = me.body.Head();
+
+    const char dirs[] = {'R', 'L', 'U', 'D'};
+    const char back[] = {'L', 'R', 'D', 'U'};
+    const int dx[] = {1, -1, 0, 0};
+    const int dy[] = {0, 0, -1, 1};
+    int bestScore = -1;
+    char best = me.key;
+    int offset = (int)(NextRandom(c.rng) % 4);
+    for (int k = 0; k < 4; k++)
+    {
+        int d = (k + offset) % 4;
+        if (back[d] == me.key)
+            continue;
+        int x = head.x + dx[d];
+        int y = head.y + dy[d];
+        if (x < 0 || x >= c.mirror.width || y < 0 || y >= c.mirror.height)
+            continue;
+        int owner = c.mirror.owner[y * c.mirror.width + x];
+        if (owner > 0)
+            continue;
+        int score = owner < 0 ? 100 : 1;
+        if (dirs[d] == me.key && NextRandom(c.rng) % 8 != 0)
+            score += 10;
+        if (score > bestScore)
+        {
+            bestScore = score;
+            best = dirs[d];
+        }
+    }
+    if (best == me.key)
+        return;
+
+    uint32_t turn = c.nextTurn++;
+    c.turnSentAt.resize(turn + 1, 0);
+    c.turnSentAt[turn] = NowNs();
+    AppendMessage(c.out, MSG_TURN, EncodeTurn(turn, best));
+}
+
+static bool HandleMessage(BotClient &c, uint8_t type, const unsigned char *payload, size_t size)
+{
+    int width, height;
+    switch (type)
+    {
+    case MSG_WELCOME:
+        if (c.welcomed || !DecodeWelcome(payload, size, c.snake, width, height, c.tickRate))
+            return false;
+        c.mirror.width = width;
+        c.mirror.height = height;
+        c.welcomed = true;
+        return true;
+    case MSG_SNAPSHOT:
+        if (!c.welcomed || c.synced || !ApplySnapshot(c.mirror, c.mirror.width, c.mirror.height, payload, size))
+            return false;
+        c.synced = true;
+        c.lastTick = c.mirror.tick;
+        return true;
+    case MSG_TICK:
+    {
+        TickInfo info;
+        if (!c.synced || !ApplyTick(c.mirror, payload, size, info))
+            return false;
+        uint64_t now = NowNs();
+        if (info.tick != c.lastTick + 1)
+            c.missedTicks++;
+        else if (c.lastReceivedAt != 0)
+        {
+            double transit = (double)(int64_t)(now - c.lastReceivedAt) - (double)(int64_t)(info.sentAt - c.lastSentAt);
+            tickJitterMs.push_back(std::abs(transit) / 1e6);
+        }
+        c.lastSentAt = info.sentAt;
+        c.lastReceivedAt = now;
+        c.ticks++;
+        c.lastTick = info.tick;
+        if (info.checksum != ArenaChecksum(c.mirror))
+            c.desyncs++;
+        for (uint32_t t = c.ackedTurn + 1; t <= info.lastTurn && t < c.turnSentAt.size(); t++)
+            turnLatencyMs.push_back((now - c.turnSentAt[t]) / 1e6);
+        c.ackedTurn = std::max(c.ackedTurn, info.lastTurn);
+        Steer(c);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static void Pump(BotClient &c)
+{
+    if (!ReadSocket(c.fd, c.in, c.received))
+    {
+        c.failed = true;
+        return;
+    }
+    size_t offset = 0;
+    uint8_t type;
+    const unsigned char *payload;
+    size_t size, next;
+    while (PeekMessage(c.in, offset, type, payload, size, next))
+    {
+        if (!HandleMessage(c, type, payload, size))
+        {
+            c.failed = true;
+            return;
+        }
+        offset = next;
+    }
+    c.in.erase(0, offset);
+
+    size_t before = c.out.size();
+    if (!FlushSocket(c.fd, c.out))
+        c.failed = true;
+    c.sent += before - c.out.size();
+}
+
+static double Percentile(std::vector<double> &values, double pct)
+{
+    if (values.empty())
+        return 0.0;
+    size_t k = (size_t)(pct / 100.0 * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+static bool ParseArgs(int argc, char **argv)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const char *arg = argv[i];
+        const char *value = argv[i + 1];
+        if (strcmp(arg, "--host") == 0)
+            settings.host = value;
+        else if (strcmp(arg, "--port") == 0)
+            settings.port = atoi(value);
+        else if (strcmp(arg, "--clients") == 0)
+            settings.clients = atoi(value);
+        else if (strcmp(arg, "--seconds") == 0)
+            settings.seconds = atof(value);
+        else
+            return false;
+    }
+    return argc % 2 == 1 && settings.port > 0 && settings.clients > 0 && settings.seconds > 0.0;
+}
+
+int main(int argc, char **argv)
+{
+    if (!ParseArgs(argc, argv))
+    {
+        fprintf(stderr, "usage: snake_fleet [--host H] [--port P] [--clients N] [--seconds N]\n");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<BotClient *> clients;
+    for (int i = 0; i < settings.clients; i++)
+    {
+        BotClient *c = new BotClient();
+        c->fd = ConnectTcp(settings.host, settings.port);
+        if (c->fd < 0)
+        {
+            fprintf(stderr, "could not connect to %s:%d\n", settings.host, settings.port);
+            return 1;
+        }
+        c->rng = (uint64_t)i + 1;
+        std::string hello(1, (char)netVersion);
+        AppendMessage(c->out, MSG_HELLO, hello);
+        clients.push_back(c);
+    }
+
+    std::vector<pollfd> polls;
+    uint64_t start = NowNs();
+    uint64_t end = start + (uint64_t)(settings.seconds * 1e9);
+    while (NowNs() < end)
+    {
+        polls.clear();
+        for (BotClient *c : clients)
+        {
+            if (!c->failed)
+                polls.push_back({c->fd, (short)(POLLIN | (c->out.empty() ? 0 : POLLOUT)), 0});
+        }
+        if (polls.empty())
+            break;
+        poll(polls.data(), polls.size(), 10);
+        for (BotClient *c : clients)
+        {
+            if (!c->failed)
+                Pump(*c);
+        }
+    }
+    double elapsed = (NowNs() - start) / 1e9;
+
+    uint64_t received = 0, sent = 0, ticks = 0, missed = 0, desyncs = 0;
+    int failed = 0;
+    for (BotClient *c : clients)
+    {
+        received += c->received;
+        sent += c->sent;
+        ticks += c->ticks;
+        missed += c->missedTicks;
+        desyncs += c->desyncs;
+        failed += c->failed;
+        close(c->fd);
+    }
+
+    int n = settings.clients;
+    printf("clients=%d seconds=%.1f failed=%d\n", n, elapsed, failed);
+    printf("per client: down %.2f kB/s (%.0f bytes/tick), up %.0f B/s, %.1f ticks/s\n", received / elapsed / 1024.0 / n,
+           ticks ? (double)received / ticks : 0.0, sent / elapsed / n, ticks / elapsed / n);
+    printf("tick jitter ms: p50 %.3f p99 %.3f max %.3f\n", Percentile(tickJitterMs, 50), Percentile(tickJitterMs, 99),
+           Percentile(tickJitterMs, 100));
+    printf("turn latency ms: p50 %.3f p99 %.3f max %.3f (%zu turns)\n", Percentile(turnLatencyMs, 50),
+           Percentile(turnLatencyMs, 99), Percentile(turnLatencyMs, 100), turnLatencyMs.size());
+    printf("missed ticks %llu, checksum mismatches %llu\n", (unsigned long long)missed, (unsigned long long)desyncs);
+
+    for (BotClient *c : clients)
+        delete c;
+    return desyncs == 0 && failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,274 @@
+// authoritative arena server. runs the arena at a fixed tick rate, every
+// connected client steers one snake and gets only what changed each tick
+//
+// usage: snake_server [options]
+//   --port P         tcp port (default 7777)
+//   --rate R         ticks per second (default 20)
+//   --grid WxH       board size (default 240x135)
+//   --bots N         bot snakes besides the players (default 300)
+//   --seed S         arena seed (default 1)
+//   --seconds N      stop after N seconds (default: run until killed)
+//
+// once a second it prints the tick cost and what each client was sent
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <vector>
+#include <poll.h>
+#include "arena.h"
+#include "netproto.h"
+#include "netsocket.h"
+
+// a client that stops reading gets dropped once this much is queued for it
+static const size_t maxQueued = 4 << 20;
+
+struct Client
+{
+    int fd = -1;
+    int snake = -1;
+    bool joined = false; // said hello, gets ticks
+    uint32_t lastTurn = 0;
+    std::string in;
+    std::string out;
+    uint64_t received = 0;
+    uint64_t sent = 0;
+};
+
+struct Settings
+{
+    int port = 7777;
+    int rate = 20;
+    int gridX = 240;
+    int gridY = 135;
+    int bots = 300;
+    unsigned long long seed = 1;
+    double seconds = 0.0;
+};
+
+static Settings settings;
+
+// hands the client a snake, one a player left behind when there is one
+static int TakeSnake(Arena &arena, const std::vector<Client *> &clients)
+{
+    for (int i = settings.bots; i < (int)arena.snakes.size(); i++)
+    {
+        bool taken = false;
+        for (const Client *c : clients)
+            taken = taken || c->snake == i;
+        if (!taken)
+        {
+            arena.snakes[i].player = true;
+            arena.snakes[i].turn = 0;
+            return i;
+        }
+    }
+    return AddArenaSnake(arena, true);
+}
+
+// reads everything the client sent, false if it broke the protocol or left
+static bool ReadClient(Arena &arena, Client &c)
+{
+    if (!ReadSocket(c.fd, c.in, c.received))
+        return false;
+
+    size_t offset = 0;
+    uint8_t type;
+    const unsigned char *payload;
+    size_t size, next;
+    while (PeekMessage(c.in, offset, type, payload, size, next))
+    {
+        if (type == MSG_HELLO && !c.joined)
+        {
+            if (size != 1 || payload[0] != netVersion)
+                return false;
+            AppendMessage(c.out, MSG_WELCOME, EncodeWelcome(c.snake, arena.width, arena.height, settings.rate));
+            AppendMessage(c.out, MSG_SNAPSHOT, EncodeSnapshot(arena));
+            c.joined = true;
+        }
+        else if (type == MSG_TURN && c.joined)
+        {
+            uint32_t turn;
+            char key;
+            if (!DecodeTurn(payload, size, turn, key))
+                return false;
+            arena.snakes[c.snake].turn = key;
+            c.lastTurn = turn;
+        }
+        else
+        {
+            return false;
+        }
+        offset = next;
+    }
+
+    // a header claiming more than any message can be is never going to complete
+    if (c.in.size() - offset >= 4)
+    {
+        const unsigned char *p = (const unsigned char *)c.in.data() + offset;
+        uint32_t length = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        if (length == 0 || length > netMaxMessage)
+            return false;
+    }
+    c.in.erase(0, offset);
+    return true;
+}
+
+static void Usage()
+{
+    fprintf(stderr, "usage: snake_server [--port P] [--rate R] [--grid WxH] [--bots N] [--seed S] [--seconds N]\n");
+}
+
+static bool ParseArgs(int argc, char **argv)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const char *arg = argv[i];
+        const char *value = argv[i + 1];
+        if (strcmp(arg, "--port") == 0)
+            settings.port = atoi(value);
+        else if (strcmp(arg, "--rate") == 0)
+            settings.rate = atoi(value);
+        else if (strcmp(arg, "--grid") == 0)
+        {
+            if (sscanf(value, "%dx%d", &settings.gridX, &settings.gridY) != 2)
+                return false;
+        }
+        else if (strcmp(arg, "--bots") == 0)
+            settings.bots = atoi(value);
+        else if (strcmp(arg, "--seed") == 0)
+            settings.seed = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--seconds") == 0)
+            settings.seconds = atof(value);
+        else
+            return false;
+    }
+    return argc % 2 == 1 && settings.port > 0 && settings.rate >= 1 && settings.rate <= 1000 && settings.gridX >= 10 &&
+           settings.gridY >= 10 && settings.bots >= 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (!ParseArgs(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = ListenTcp(settings.port);
+    if (listener < 0)
+    {
+        fprintf(stderr, "could not listen on port %d\n", settings.port);
+        return 1;
+    }
+
+    Arena *arena = new Arena();
+    InitArena(*arena, settings.gridX, settings.gridY, settings.bots, std::max(settings.bots, 16), settings.seed);
+    arena->logChanges = true;
+    printf("arena %dx%d, %d bots, %d ticks/s on port %d\n", settings.gridX, settings.gridY, settings.bots, settings.rate,
+           settings.port);
+    fflush(stdout);
+
+    std::vector<Client *> clients;
+    std::vector<pollfd> polls;
+    std::vector<double> tickMs;
+    const uint64_t period = 1000000000ull / settings.rate;
+    uint64_t start = NowNs();
+    uint64_t nextTick = start + period;
+    uint64_t lastReport = start;
+    uint64_t sentSinceReport = 0;
+
+    while (settings.seconds <= 0.0 || NowNs() - start < (uint64_t)(settings.seconds * 1e9))
+    {
+        // wait for input until the tick is due
+        polls.clear();
+        polls.push_back({listener, POLLIN, 0});
+        for (Client *c : clients)
+            polls.push_back({c->fd, (short)(POLLIN | (c->out.empty() ? 0 : POLLOUT)), 0});
+        uint64_t now = NowNs();
+        int waitMs = now < nextTick ? (int)((nextTick - now + 999999) / 1000000) : 0; // rounded up, 0 would spin
+        poll(polls.data(), polls.size(), waitMs);
+
+        while (true)
+        {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0)
+                break;
+            PrepareSocket(fd);
+            Client *c = new Client();
+            c->fd = fd;
+            c->snake = TakeSnake(*arena, clients);
+            clients.push_back(c);
+        }
+
+        for (size_t i = 0; i < clients.size();)
+        {
+            Client *c = clients[i];
+            bool ok = ReadClient(*arena, *c);
+            uint64_t before = c->out.size();
+            ok = ok && FlushSocket(c->fd, c->out) && c->out.size() <= maxQueued;
+            c->sent += before - c->out.size();
+            sentSinceReport += before - c->out.size();
+            if (ok)
+            {
+                i++;
+                continue;
+            }
+
+            // the snake plays on as a bot until someone else takes it
+            arena->snakes[c->snake].player = false;
+            close(c->fd);
+            delete c;
+            clients.erase(clients.begin() + i);
+        }
+
+        if (NowNs() < nextTick)
+            continue;
+        nextTick += period;
+        if (NowNs() > nextTick)
+            nextTick = NowNs() + period; // fell behind, don't try to catch up in a burst
+
+        uint64_t tickStart = NowNs();
+        StepArena(*arena);
+        std::string common = EncodeTick(*arena, NowNs());
+        for (Client *c : clients)
+        {
+            if (!c->joined)
+                continue;
+            std::string payload = common;
+            AppendTickAck(payload, c->lastTurn);
+            AppendMessage(c->out, MSG_TICK, payload);
+            uint64_t before = c->out.size();
+            FlushSocket(c->fd, c->out);
+            c->sent += before - c->out.size();
+            sentSinceReport += before - c->out.size();
+        }
+        tickMs.push_back((NowNs() - tickStart) / 1e6);
+
+        if (NowNs() - lastReport >= 1000000000ull)
+        {
+            double seconds = (NowNs() - lastReport) / 1e9;
+            std::sort(tickMs.begin(), tickMs.end());
+            int joined = 0;
+            for (const Client *c : clients)
+                joined += c->joined;
+            printf("tick %u  alive %d  clients %d  tick ms p50 %.3f max %.3f  out %.1f kB/s per client\n", arena->tick,
+                   ArenaAliveCount(*arena), joined, tickMs[tickMs.size() / 2], tickMs.back(),
+                   joined ? sentSinceReport / seconds / 1024.0 / joined : 0.0);
+            fflush(stdout);
+            tickMs.clear();
+            sentSinceReport = 0;
+            lastReport = NowNs();
+        }
+    }
+
+    for (Client *c : clients)
+    {
+        close(c->fd);
+        delete c;
+    }
+    close(listener);
+    delete arena;
+    return 0;
+}
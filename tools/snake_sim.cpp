@@ -0,0 +1,238 @@
+// headless runner for the simulation core, links without raylib
+//
+// usage: snake_sim [mode 0-4] [ticks] [gridX] [gridY] [seed]
+//        snake_sim --record [mode 0-4] [games] [gridX] [gridY] [seed]
+//        snake_sim --replay [--level-file F] file...
+//
+// story replays play on the built in levels unless --level-file names the
+// level text they were recorded with
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include "game.h"
+#include "replay.h"
+
+// where the head would end up going in direction dir, false if it hits a wall
+static bool NextCell(GameState &game, char dir, int &x, int &y)
+{
+    x = game.snake.Head().x;
+    y = game.snake.Head().y;
+    switch (dir)
+    {
+    case 'R':
+        x++;
+        break;
+    case 'L':
+        x--;
+        break;
+    case 'U':
+        y--;
+        break;
+    case 'D':
+        y++;
+        break;
+    }
+    if (x < 0 || x >= game.gridCountX || y < 0 || y >= game.gridCountY)
+    {
+        if (WallsActive(game))
+            return false;
+        x = (x + game.gridCountX) % game.gridCountX;
+        y = (y + game.gridCountY) % game.gridCountY;
+    }
+    return true;
+}
+
+// greedy bot, heads for the food and avoids anything that kills it right away
+static Input ChooseInput(GameState &game)
+{
+    const char dirs[] = {'R', 'L', 'U', 'D'};
+    const char opposite[] = {'L', 'R', 'D', 'U'};
+    Input best;
+    int bestDist = -1;
+    for (int i = 0; i < 4; i++)
+    {
+        if (game.key == opposite[i])
+            continue;
+        int x, y;
+        if (!NextCell(game, dirs[i], x, y) || IsTileBlocked(x, y, game, HurdlesActive(game)))
+            continue;
+        int dist = abs(x - game.foodX) + abs(y - game.foodY);
+        if (bestDist < 0 || dist < bestDist)
+        {
+            bestDist = dist;
+            best.key = dirs[i];
+        }
+    }
+    return best;
+}
+
+// plays ticks of bot games back to back and reports throughput
+static int RunBots(int mode, long long ticks, int gridX, int gridY, unsigned long long seed)
+{
+    GameState *game = new GameState();
+    game->currentMode = (GameMode)mode;
+    game->gridCountX = gridX;
+    game->gridCountY = gridY;
+    SeedRandom(*game, seed);
+    ResetGame(*game, true);
+
+    long long games = 1;
+    long long wins = 0;
+    long long totalScore = 0;
+    int bestScore = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (long long t = 0; t < ticks; t++)
+    {
+        int events = Step(*game, ChooseInput(*game));
+        if (events & EVENT_WON)
+            wins++;
+        if (events & (EVENT_DIED | EVENT_WON))
+        {
+            totalScore += game->score;
+            if (game->score > bestScore)
+                bestScore = game->score;
+            ResetGame(*game, true);
+            games++;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("mode=%d grid=%dx%d seed=%llu\n", mode, gridX, gridY, seed);
+    printf("ticks=%lld games=%lld wins=%lld best=%d avg=%.1f\n", ticks, games, wins, bestScore, (double)totalScore / games);
+    printf("time=%.3fs rate=%.0f ticks/s\n", seconds, ticks / seconds);
+
+    delete game;
+    return 0;
+}
+
+// plays count bot games to the end and writes each one as bot_NNNN.replay
+static int RecordBots(int count, int mode, int gridX, int gridY, unsigned long long seed)
+{
+    const uint32_t maxTicks = 1000000;
+    GameState *game = new GameState();
+    game->currentMode = (GameMode)mode;
+    game->gridCountX = gridX;
+    game->gridCountY = gridY;
+    SeedRandom(*game, seed);
+
+    Replay rec;
+    for (int i = 0; i < count; i++)
+    {
+        StartRecording(rec, *game, seed + i);
+        while (!game->gameOver && rec.tickCount < maxTicks)
+        {
+            // only actual turns go in the log
+            Input input = ChooseInput(*game);
+            if (input.key == game->key)
+                input.key = 0;
+            Step(*game, input);
+            RecordTick(rec, input);
+        }
+        FinishRecording(rec, *game);
+
+        char path[64];
+        snprintf(path, sizeof(path), "bot_%04d.replay", i);
+        std::string data = EncodeReplay(rec);
+        FILE *f = fopen(path, "wb");
+        if (!f || fwrite(data.data(), 1, data.size(), f) != data.size())
+        {
+            fprintf(stderr, "could not write %s\n", path);
+            if (f)
+                fclose(f);
+            delete game;
+            return 1;
+        }
+        fclose(f);
+        printf("%s ticks=%u score=%d bytes=%zu\n", path, rec.tickCount, rec.finalScore, data.size());
+    }
+
+    delete game;
+    return 0;
+}
+
+// replays each file as fast as possible and checks it ends the way it was recorded
+static int PlayReplays(int count, char **paths, const LevelSet &levels)
+{
+    int failures = 0;
+    ReplayPlayer *player = new ReplayPlayer();
+    player->game.levels = &levels;
+    for (int i = 0; i < count; i++)
+    {
+        Replay rec;
+        if (!ReadReplayFile(paths[i], rec))
+        {
+            printf("%s: unreadable\n", paths[i]);
+            failures++;
+            continue;
+        }
+        if (!ReplayMatchesLevels(rec, levels))
+        {
+            printf("%s: recorded on other story levels, pass their file with --level-file\n", paths[i]);
+            failures++;
+            continue;
+        }
+
+        // no keyframes needed when only running start to finish
+        StartPlayback(*player, rec, 0xFFFFFFFFu);
+        auto start = std::chrono::steady_clock::now();
+        while (!PlaybackFinished(*player))
+            PlaybackStep(*player);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        bool match = rec.finalScore < 0 || player->game.score == rec.finalScore;
+        if (!match)
+            failures++;
+        printf("%s: ticks=%u score=%d expected=%d %s rate=%.0f ticks/s\n", paths[i], player->tick, player->game.score,
+               rec.finalScore, match ? "ok" : "MISMATCH", player->tick / (seconds > 0 ? seconds : 1e-9));
+    }
+    delete player;
+    return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--replay") == 0)
+    {
+        LevelSet levels = DefaultLevels();
+        int first = 2;
+        if (argc > 3 && strcmp(argv[2], "--level-file") == 0)
+        {
+            std::string cache, error;
+            if (!LoadLevels(argv[3], "", levels, cache, error))
+            {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+            first = 4;
+        }
+        return PlayReplays(argc - first, argv + first, levels);
+    }
+
+    bool record = argc > 1 && strcmp(argv[1], "--record") == 0;
+    if (record)
+    {
+        argc--;
+        argv++;
+    }
+
+    int mode = argc > 1 ? atoi(argv[1]) : NORMAL;
+    long long ticks = argc > 2 ? atoll(argv[2]) : (record ? 10 : 10000000);
+    int gridX = argc > 3 ? atoi(argv[3]) : 44;
+    int gridY = argc > 4 ? atoi(argv[4]) : 24;
+    unsigned long long seed = argc > 5 ? strtoull(argv[5], nullptr, 10) : 1;
+
+    if (mode < EASY || mode > MAZE || gridX < 10 || gridY < 10 || ticks <= 0)
+    {
+        fprintf(stderr, "usage: snake_sim [mode 0-4] [ticks] [gridX>=10] [gridY>=10] [seed]\n");
+        fprintf(stderr, "       snake_sim --record [mode 0-4] [games] [gridX] [gridY] [seed]\n");
+        fprintf(stderr, "       snake_sim --replay file...\n");
+        return 1;
+    }
+
+    if (record)
+        return RecordBots((int)ticks, mode, gridX, gridY, seed);
+    return RunBots(mode, ticks, gridX, gridY, seed);
+}
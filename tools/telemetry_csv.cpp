@@ -0,0 +1,86 @@
+// turns a telemetry log written by the game into csv on stdout, with a
+// summary of the session on stderr
+//
+// usage: snake_telemetry [telemetry.log]
+//
+// columns: time in ms since the session started, tick, event, detail (death
+// cause or mode, empty for the rest), value (see TelemetryType)
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "game.h"
+#include "telemetry.h"
+
+static bool ReadWholeFile(const char *path, std::string &data)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        data.append(chunk, n);
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
+
+static const char *DetailName(const TelemetryEvent &event)
+{
+    static const char *causes[] = {"none", "wall", "self", "hurdle"};
+    static const char *modes[] = {"easy", "normal", "hard", "story", "maze"};
+    if (event.type == TELEMETRY_DEATH && event.detail <= DEATH_HURDLE)
+        return causes[event.detail];
+    if (event.type == TELEMETRY_GAME && event.detail <= MAZE)
+        return modes[event.detail];
+    return "";
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : telemetryPath;
+    std::string data;
+    if (!ReadWholeFile(path, data))
+    {
+        fprintf(stderr, "can't read %s\n", path);
+        return 1;
+    }
+    int64_t startTime;
+    std::vector<TelemetryEvent> events;
+    if (!DecodeTelemetryLog(data, startTime, events))
+    {
+        fprintf(stderr, "%s is not a telemetry log\n", path);
+        return 1;
+    }
+
+    long long counts[TELEMETRY_TYPES + 1] = {};
+    long long dropped = 0;
+    int64_t tickNanos = 0, slowestTick = 0;
+    printf("time_ms,tick,event,detail,value\n");
+    for (const TelemetryEvent &event : events)
+    {
+        printf("%.3f,%u,%s,%s,%d\n", event.time / 1e6, event.tick, TelemetryTypeName(event.type), DetailName(event),
+               event.value);
+        counts[event.type < TELEMETRY_TYPES ? event.type : TELEMETRY_TYPES]++;
+        if (event.type == TELEMETRY_DROPPED)
+            dropped += event.value;
+        if (event.type == TELEMETRY_TICK)
+        {
+            tickNanos += event.value;
+            if (event.value > slowestTick)
+                slowestTick = event.value;
+        }
+    }
+
+    double seconds = events.empty() ? 0.0 : events.back().time / 1e9;
+    fprintf(stderr, "session started %lld, %.1f s, %zu events, %lld dropped\n", (long long)startTime, seconds,
+            events.size(), dropped);
+    fprintf(stderr, "games %lld, food %lld, deaths %lld, wins %lld, levels %lld, saves %lld\n", counts[TELEMETRY_GAME],
+            counts[TELEMETRY_FOOD], counts[TELEMETRY_DEATH], counts[TELEMETRY_WON], counts[TELEMETRY_LEVEL],
+            counts[TELEMETRY_SAVE]);
+    if (counts[TELEMETRY_TICK] > 0)
+        fprintf(stderr, "ticks %lld, %.1f us on average, %.1f us slowest\n", counts[TELEMETRY_TICK],
+                tickNanos / 1e3 / counts[TELEMETRY_TICK], slowestTick / 1e3);
+    return 0;
+}
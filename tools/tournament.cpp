@@ -0,0 +1,412 @@
+// plays many autopilot games headless on every core and reports how they went.
+// games are handed out in chunks from one queue per thread, a thread that
+// runs dry steals from the others, and each thread keeps its own totals that
+// are merged once at the end, so nothing is shared while games are running
+//
+// usage: tournament [options]
+//   --games N        games to play (default 10000)
+//   --mode M         0 easy, 1 normal, 2 hard, 3 story, 4 maze (default 1)
+//   --grid WxH       board size (default 45x24, a 1080p screen)
+//   --bot path|cycle autopilot to play with (default path)
+//   --threads T      worker threads (default: every core)
+//   --seed S         game i is seeded with S + i, results don't depend on T
+//   --max-ticks N    stop every game after N ticks (default: no limit)
+//   --max-idle N     call a game stalled after N ticks without food (default 4 per cell)
+//   --level-file F   story levels to play (default: the built in three)
+//   --levels A,B,..  scores that reach story level 2, 3 and on (default: the level file's)
+//   --maze-density D share of cells maze mode tries to block, 0 to 1 (default 0.3)
+//   --speed S,D,M    move interval start, step per food, minimum (default 0.1,0.001,0.05)
+//   --heatmap FILE   write how often the head was on each cell as a pgm image
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "game.h"
+#include "autopilot.h"
+
+struct Settings
+{
+    int games = 10000;
+    int mode = NORMAL;
+    int gridX = 45;
+    int gridY = 24;
+    AutopilotMode bot = AUTOPILOT_PATH;
+    int threads = 0;
+    unsigned long long seed = 1;
+    long long maxTicks = 0;
+    long long maxIdle = 0;
+    const char *levelFile = nullptr;
+    std::vector<int> levelScores;
+    float mazeDensity = 0.3f;
+    float speed[3] = {0.1f, 0.001f, 0.05f};
+    const char *heatmapPath = nullptr;
+};
+
+// one thread's share of the results
+struct Totals
+{
+    long long games = 0;
+    long long ticks = 0;
+    long long wins = 0;
+    long long stalls = 0;
+    long long deaths[4] = {0, 0, 0, 0}; // by DeathCause
+    double seconds = 0.0;               // simulated play time from the move intervals
+    std::vector<uint64_t> heat;         // ticks the head spent on each cell
+};
+
+// a run of consecutive game numbers
+struct Chunk
+{
+    int first;
+    int count;
+};
+
+// the owner takes chunks from the back, thieves from the front
+struct WorkQueue
+{
+    std::mutex lock;
+    std::deque<Chunk> chunks;
+};
+
+static Settings settings;
+static LevelSet levels;
+static std::vector<WorkQueue *> queues;
+static std::vector<Totals *> totals;
+static std::vector<uint32_t> gameScores; // per game, each slot is written by one thread only
+static std::vector<uint32_t> gameTicks;
+
+static bool TakeChunk(int self, Chunk &chunk)
+{
+    int count = (int)queues.size();
+    for (int k = 0; k < count; k++)
+    {
+        WorkQueue &q = *queues[(self + k) % count];
+        std::lock_guard<std::mutex> hold(q.lock);
+        if (q.chunks.empty())
+            continue;
+        if (k == 0)
+        {
+            chunk = q.chunks.back();
+            q.chunks.pop_back();
+        }
+        else
+        {
+            chunk = q.chunks.front();
+            q.chunks.pop_front();
+        }
+        return true;
+    }
+    return false; // nothing is ever added once started, so empty everywhere means done
+}
+
+static void PlayGame(int index, GameState &game, Autopilot &ap, Totals &t)
+{
+    SeedRandom(game, settings.seed + (unsigned long long)index);
+    ResetGame(game, true);
+    ResetAutopilot(ap);
+
+    int w = game.gridCountX;
+    long long ticks = 0;
+    long long lastFood = 0;
+    while (!game.gameOver && ticks - lastFood < settings.maxIdle)
+    {
+        if (settings.maxTicks > 0 && ticks >= settings.maxTicks)
+            break;
+
+        const Cell &head = game.snake.Head();
+        t.heat[(size_t)head.y * w + head.x]++;
+        t.seconds += game.moveInterval;
+        int events = Step(game, AutopilotDecide(ap, game));
+        ticks++;
+        if (events & EVENT_ATE_FOOD)
+            lastFood = ticks;
+    }
+
+    t.games++;
+    t.ticks += ticks;
+    if (game.gameWon)
+        t.wins++;
+    else if (!game.gameOver)
+        t.stalls++;
+    else
+        t.deaths[game.deathCause]++;
+    gameScores[index] = (uint32_t)game.score;
+    gameTicks[index] = (uint32_t)std::min<long long>(ticks, 0xFFFFFFFFll);
+}
+
+static void Worker(int self)
+{
+    GameState *game = new GameState();
+    game->currentMode = (GameMode)settings.mode;
+    game->gridCountX = settings.gridX;
+    game->gridCountY = settings.gridY;
+    game->levels = &levels;
+    game->mazeDensity = settings.mazeDensity;
+    game->startInterval = settings.speed[0];
+    game->intervalStep = settings.speed[1];
+    game->minInterval = settings.speed[2];
+
+    Autopilot *ap = new Autopilot();
+    ap->mode = settings.bot;
+
+    Totals &t = *totals[self];
+    t.heat.assign((size_t)settings.gridX * settings.gridY, 0);
+
+    Chunk chunk;
+    while (TakeChunk(self, chunk))
+    {
+        for (int i = chunk.first; i < chunk.first + chunk.count; i++)
+            PlayGame(i, *game, *ap, t);
+    }
+
+    delete ap;
+    delete game;
+}
+
+// adds every thread's heatmap into the first one, each thread summing its own slice of cells
+static void MergeHeat(int self, int threads)
+{
+    std::vector<uint64_t> &into = totals[0]->heat;
+    size_t cells = into.size();
+    size_t begin = cells * self / threads;
+    size_t end = cells * (self + 1) / threads;
+    for (size_t t = 1; t < totals.size(); t++)
+    {
+        const std::vector<uint64_t> &from = totals[t]->heat;
+        for (size_t i = begin; i < end; i++)
+            into[i] += from[i];
+    }
+}
+
+static double Percentile(std::vector<uint32_t> values, double pct)
+{
+    if (values.empty())
+        return 0.0;
+    size_t k = (size_t)(pct / 100.0 * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+static bool WriteHeatmap(const char *path, const std::vector<uint64_t> &heat, int w, int h)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+
+    // log scale, otherwise the start cell drowns everything else out
+    uint64_t most = 1;
+    for (uint64_t v : heat)
+        most = std::max(most, v);
+    double scale = 255.0 / log(1.0 + (double)most);
+    fprintf(f, "P5\n%d %d\n255\n", w, h);
+    std::vector<unsigned char> row(w);
+    bool ok = true;
+    for (int y = 0; y < h && ok; y++)
+    {
+        for (int x = 0; x < w; x++)
+            row[x] = (unsigned char)(log(1.0 + (double)heat[(size_t)y * w + x]) * scale + 0.5);
+        ok = fwrite(row.data(), 1, row.size(), f) == row.size();
+    }
+    return fclose(f) == 0 && ok;
+}
+
+static void Usage()
+{
+    fprintf(stderr, "usage: tournament [--games N] [--mode 0-4] [--grid WxH] [--bot path|cycle] [--threads T]\n");
+    fprintf(stderr, "                  [--seed S] [--max-ticks N] [--max-idle N]\n");
+    fprintf(stderr, "                  [--level-file F] [--levels A,B,..] [--maze-density D]\n");
+    fprintf(stderr, "                  [--speed S,D,M] [--heatmap FILE]\n");
+}
+
+static bool ParseArgs(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value)
+            return false;
+        i++;
+
+        if (strcmp(arg, "--games") == 0)
+            settings.games = atoi(value);
+        else if (strcmp(arg, "--mode") == 0)
+            settings.mode = atoi(value);
+        else if (strcmp(arg, "--grid") == 0)
+        {
+            if (sscanf(value, "%dx%d", &settings.gridX, &settings.gridY) != 2)
+                return false;
+        }
+        else if (strcmp(arg, "--bot") == 0)
+        {
+            if (strcmp(value, "path") == 0)
+                settings.bot = AUTOPILOT_PATH;
+            else if (strcmp(value, "cycle") == 0)
+                settings.bot = AUTOPILOT_CYCLE;
+            else
+                return false;
+        }
+        else if (strcmp(arg, "--threads") == 0)
+            settings.threads = atoi(value);
+        else if (strcmp(arg, "--seed") == 0)
+            settings.seed = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--max-ticks") == 0)
+            settings.maxTicks = atoll(value);
+        else if (strcmp(arg, "--max-idle") == 0)
+            settings.maxIdle = atoll(value);
+        else if (strcmp(arg, "--level-file") == 0)
+            settings.levelFile = value;
+        else if (strcmp(arg, "--levels") == 0)
+        {
+            settings.levelScores.clear();
+            for (const char *p = value; *p;)
+            {
+                char *end;
+                settings.levelScores.push_back((int)strtol(p, &end, 10));
+                if (end == p || (*end != ',' && *end != '\0'))
+                    return false;
+                p = *end ? end + 1 : end;
+            }
+        }
+        else if (strcmp(arg, "--maze-density") == 0)
+            settings.mazeDensity = (float)atof(value);
+        else if (strcmp(arg, "--speed") == 0)
+        {
+            if (sscanf(value, "%f,%f,%f", &settings.speed[0], &settings.speed[1], &settings.speed[2]) != 3)
+                return false;
+        }
+        else if (strcmp(arg, "--heatmap") == 0)
+            settings.heatmapPath = value;
+        else
+            return false;
+    }
+    return settings.games > 0 && settings.mode >= EASY && settings.mode <= MAZE && settings.gridX >= 10 &&
+           settings.gridY >= 10 && settings.threads >= 0 && settings.maxTicks >= 0 &&
+           settings.maxIdle >= 0 && settings.mazeDensity >= 0.0f && settings.mazeDensity <= 1.0f;
+}
+
+int main(int argc, char **argv)
+{
+    if (!ParseArgs(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    // one off runs read the text directly, the cache is the game's business
+    levels = DefaultLevels();
+    std::string cache, error;
+    if (settings.levelFile && !LoadLevels(settings.levelFile, "", levels, cache, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    if (settings.levelScores.size() >= levels.levels.size())
+    {
+        fprintf(stderr, "--levels has %zu scores for %zu levels\n", settings.levelScores.size(), levels.levels.size());
+        return 1;
+    }
+    for (size_t i = 0; i < settings.levelScores.size(); i++)
+        levels.levels[i + 1].score = settings.levelScores[i];
+    levels.crc = LevelSetCrc(levels);
+
+    if (settings.threads == 0)
+        settings.threads = std::max(1u, std::thread::hardware_concurrency());
+    if (settings.maxIdle == 0)
+        settings.maxIdle = 4ll * settings.gridX * settings.gridY;
+    int threads = settings.threads;
+
+    // small chunks so the last games spread out over every thread
+    const int chunkSize = 16;
+    for (int t = 0; t < threads; t++)
+    {
+        queues.push_back(new WorkQueue());
+        totals.push_back(new Totals());
+    }
+    for (int first = 0, n = 0; first < settings.games; first += chunkSize, n++)
+        queues[n % threads]->chunks.push_back({first, std::min(chunkSize, settings.games - first)});
+    gameScores.assign(settings.games, 0);
+    gameTicks.assign(settings.games, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++)
+        pool.emplace_back(Worker, t);
+    for (std::thread &th : pool)
+        th.join();
+    pool.clear();
+    for (int t = 0; t < threads; t++)
+        pool.emplace_back(MergeHeat, t, threads);
+    for (std::thread &th : pool)
+        th.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Totals sum;
+    for (Totals *t : totals)
+    {
+        sum.games += t->games;
+        sum.ticks += t->ticks;
+        sum.wins += t->wins;
+        sum.stalls += t->stalls;
+        sum.seconds += t->seconds;
+        for (int c = 0; c < 4; c++)
+            sum.deaths[c] += t->deaths[c];
+    }
+
+    const char *bots[] = {"off", "path", "cycle"};
+    printf("games=%lld mode=%d grid=%dx%d bot=%s threads=%d seed=%llu\n", sum.games, settings.mode, settings.gridX,
+           settings.gridY, bots[settings.bot], threads, settings.seed);
+    printf("time=%.2fs games/s=%.0f ticks/s=%.0f\n", elapsed, sum.games / elapsed, sum.ticks / elapsed);
+
+    uint32_t best = *std::max_element(gameScores.begin(), gameScores.end());
+    double meanScore = 0.0;
+    for (uint32_t s : gameScores)
+        meanScore += s;
+    meanScore /= sum.games;
+    printf("score: mean=%.1f p10=%.0f p50=%.0f p90=%.0f p99=%.0f max=%u\n", meanScore, Percentile(gameScores, 10),
+           Percentile(gameScores, 50), Percentile(gameScores, 90), Percentile(gameScores, 99), best);
+    printf("survival: mean=%.0f ticks (%.1fs) p10=%.0f p50=%.0f p90=%.0f\n", (double)sum.ticks / sum.games,
+           sum.seconds / sum.games, Percentile(gameTicks, 10), Percentile(gameTicks, 50), Percentile(gameTicks, 90));
+    printf("ends: won=%.2f%% wall=%.2f%% self=%.2f%% hurdle=%.2f%% stalled=%.2f%%\n", 100.0 * sum.wins / sum.games,
+           100.0 * sum.deaths[DEATH_WALL] / sum.games, 100.0 * sum.deaths[DEATH_SELF] / sum.games,
+           100.0 * sum.deaths[DEATH_HURDLE] / sum.games, 100.0 * sum.stalls / sum.games);
+
+    // ten equal bins up to the best score
+    const int bins = 10;
+    long long counts[bins] = {0};
+    uint32_t width = best / bins + 1;
+    for (uint32_t s : gameScores)
+        counts[std::min<uint32_t>(s / width, bins - 1)]++;
+    for (int b = 0; b < bins; b++)
+    {
+        double share = 100.0 * counts[b] / sum.games;
+        printf("  %6u-%-6u %6.2f%% ", b * width, (b + 1) * width - 1, share);
+        for (int i = 0; i < (int)(share / 2); i++)
+            putchar('#');
+        putchar('\n');
+    }
+
+    if (settings.heatmapPath)
+    {
+        if (!WriteHeatmap(settings.heatmapPath, totals[0]->heat, settings.gridX, settings.gridY))
+        {
+            fprintf(stderr, "could not write %s\n", settings.heatmapPath);
+            return 1;
+        }
+        printf("heatmap: %s\n", settings.heatmapPath);
+    }
+
+    for (int t = 0; t < threads; t++)
+    {
+        delete queues[t];
+        delete totals[t];
+    }
+    return 0;
+}